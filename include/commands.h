@@ -3,16 +3,35 @@
 
 #include <Arduino.h>
 
-void runCommand(String cmd);
+#define CMD_MAX_ARGS 8
+#define MAX_COMMAND_KEYS 160
+#define MAX_COMMAND_TABLES 8
+
+// Last argument takes the rest of the line, spaces included
+#define CMD_REST 0x01
+
+typedef void (*CommandHandler)(int argc, char** argv);
+
+// argv[0] is the command name; minArgs/maxArgs count the arguments after it.
+// Tables passed to registerCommands() must outlive the shell.
+struct Command {
+    const char* name;
+    const char* aliases;
+    const char* group;
+    uint8_t minArgs;
+    uint8_t maxArgs;
+    uint8_t flags;
+    const char* usage;
+    const char* help;
+    CommandHandler handler;
+};
+
+void initCommands();
+bool registerCommands(const Command* commands, int count);
+const Command* findCommand(const char* name);
+void runCommand(char* line);
 void showVersion();
 void showHelp();
-void showHelpOS();
-int precedence(char op);
-bool isRightAssociative(char op);
-float applyOp(float a, float b, char op);
-bool isFunction(const String& expr, int pos, const String& func);
-String getFunctionName(const String& expr, int pos);
-float applyFunction(const String& func, float value);
 void calc(String expression);
 void showMem();
 void showUptime();
@@ -23,7 +42,7 @@ void showFlashInfo();
 void showWiFiInfo();
 void fetch();
 void echoCommand(String text);
-void addToHistory(String cmd);
+void addToHistory(const char* cmd);
 void showHistory();
 
 void hexCommand(String numStr);
@@ -39,4 +58,4 @@ void killProcessCmd(int pid);
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -4,6 +4,7 @@
 #define TFT_CS   5
 #define TFT_DC   2  // Display Pins for ST7789 review README.me for full wiring setup
 #define TFT_RST  4
+#define TFT_SPI_HZ 40000000  // 80 MHz APB / 2; the 32 MHz default rounds down to 26.7 MHz
 
 
 extern const char* NTP_SERVER;
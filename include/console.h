@@ -0,0 +1,34 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <Arduino.h>
+
+#define CONSOLE_X 5
+#define CONSOLE_CHAR_W 6
+#define CONSOLE_CHAR_H 8
+#define CONSOLE_COLS 52
+#define CONSOLE_ROWS 29
+#define CONSOLE_JUMP 8
+#define CONSOLE_WIDTH (CONSOLE_COLS * CONSOLE_CHAR_W)
+
+// Bottom pixel row band left free for the status bar
+#define STATUS_Y (CONSOLE_ROWS * CONSOLE_CHAR_H)
+#define STATUS_H (240 - STATUS_Y)
+#define STATUS_FIELDS 2
+#define STATUS_FIELD_COLS (CONSOLE_COLS / STATUS_FIELDS)
+
+enum StatusField {
+    STATUS_STOPWATCH,
+    STATUS_TIMER
+};
+
+void consoleInit();
+void consoleWrite(const char* text);
+void consoleRewriteLast(const char* text);
+void consoleClear();
+void consoleRedraw();
+int16_t consoleReserve(int rows);
+void consoleStatus(int field, const char* text);
+void consoleShowStats();
+
+#endif
@@ -6,13 +6,14 @@
 
 extern Adafruit_ST7789 tft;
 extern bool screenLocked;
-extern int16_t currentCursorY;
 
-#define MAX_Y 230
+// Lines per band pushed through the display's transfer pipeline
+#define BAND_ROWS 10
 
 void initDisplay();
 void applyTheme();
 void clearScreen();
+void printLine(const char* s);
 void printLine(String s);
 void showLogo();
 void screensaver(int mode);
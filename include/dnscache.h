@@ -0,0 +1,23 @@
+#ifndef DNSCACHE_H
+#define DNSCACHE_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#define DNS_CACHE_SIZE 16
+#define DNS_HOST_MAX 64
+#define DNS_TTL_MS 300000        // hostByName() does not report record TTLs
+#define DNS_NEGATIVE_TTL_MS 30000
+
+enum DnsSource {
+    DNS_LITERAL,     // the name was already an address
+    DNS_CACHED,
+    DNS_QUERIED
+};
+
+void dnsCacheInit();
+bool dnsResolve(const char* host, IPAddress& ip, DnsSource* source = NULL);
+void dnsCacheShow();
+void dnsCacheFlush();
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <Arduino.h>
+
+#define EXPR_MAX_CODE  64
+#define EXPR_MAX_STACK 32
+
+enum ExprOp : uint8_t {
+    EXPR_PUSH_CONST,
+    EXPR_PUSH_X,
+    EXPR_ADD,
+    EXPR_SUB,
+    EXPR_MUL,
+    EXPR_DIV,
+    EXPR_MOD,
+    EXPR_POW,
+    EXPR_NEG,
+    EXPR_SQRT,
+    EXPR_SIN,
+    EXPR_COS,
+    EXPR_TAN,
+    EXPR_ASIN,
+    EXPR_ACOS,
+    EXPR_ATAN,
+    EXPR_SINH,
+    EXPR_COSH,
+    EXPR_TANH,
+    EXPR_LOG,
+    EXPR_LN,
+    EXPR_EXP,
+    EXPR_ABS,
+    EXPR_CEIL,
+    EXPR_FLOOR,
+    EXPR_ROUND
+};
+
+enum ExprStatus {
+    EXPR_OK,
+    EXPR_ERR_DIV_ZERO,
+    EXPR_ERR_MOD_ZERO
+};
+
+struct ExprInstr {
+    ExprOp op;
+    float value;
+};
+
+// Postfix program produced once by compileExpression() and replayed by
+// runExpression() for every sample; 'x' is read from a register.
+struct ExprProgram {
+    ExprInstr code[EXPR_MAX_CODE];
+    uint8_t length;
+    bool usesX;
+};
+
+bool compileExpression(const char* expression, bool allowX, ExprProgram& program, String& error);
+ExprStatus runExpression(const ExprProgram& program, float x, float& result);
+const char* exprStatusText(ExprStatus status);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FILEREADER_H
+#define FILEREADER_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define FILE_READ_BUF 1024
+#define FILE_LINE_MAX 255      // longer lines come back in pieces
+#define FILE_TAIL_DEFAULT 10
+#define FILE_PAGE_LINES 27     // console rows minus the prompt line
+
+struct LineReader {
+    File* file;
+    size_t remaining;          // bytes still allowed from the file
+    size_t pos;
+    size_t len;
+    uint8_t buf[FILE_READ_BUF];
+    char line[FILE_LINE_MAX + 1];
+};
+
+void lineReaderBegin(LineReader& r, File& file, size_t limit = SIZE_MAX);
+// Returns the next line without its '\n' (and '\r'), or NULL at the end.
+// The text stays valid until the next call.
+const char* lineReaderNext(LineReader& r, size_t* length = NULL);
+
+size_t tailOffset(File& file, int lines);
+
+#endif
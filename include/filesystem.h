@@ -2,14 +2,38 @@
 #define FILESYSTEM_H
 
 #include <Arduino.h>
+#include "fscache.h"
 
 bool initFilesystem();
 void writeFile(String name, String data);
 void appendFile(String name, String data);
 void readFile(String name);
+void readRange(String name, size_t offset, size_t length);
+void headFile(String name, int lines);
+void tailFile(String name, int lines);
+void moreFile(String name);
+void readBench(String name);
 void deleteFile(String name);
-void listFiles();
+void listFiles(String target = "", FsSort sort = FS_SORT_NAME, int flags = 0);
+void findFiles(String pattern);
 bool renameFile(String oldName, String newName);
-bool copyFile(String src, String dst);
+bool copyFile(String src, String dst, bool verify = false);
+
+#define FS_PAGE_SIZE 256                   // SPIFFS logical page
+#define FS_COPY_BUF (16 * FS_PAGE_SIZE)    // one 4 KB flash sector / LittleFS block
+#define FS_PROGRESS_MS 1000
+
+struct FsCopyResult {
+    size_t bytes;
+    uint32_t crc;          // CRC32 of the source data
+    uint32_t elapsedMs;    // copy only, without the verify pass
+    bool verified;
+};
+
+// Called after every buffer written
+typedef void (*FsProgress)(size_t done, size_t total, void* ctx);
+
+bool fsCopy(const char* src, const char* dst, bool verify, FsCopyResult* result = NULL,
+            FsProgress progress = NULL, void* ctx = NULL);
 
 #endif
\ No newline at end of file
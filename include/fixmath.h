@@ -0,0 +1,22 @@
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <Arduino.h>
+
+// Angles are in 1/1024ths of a turn; sines are Q14 (FIX_ONE == 1.0).
+#define FIX_TURN 1024
+#define FIX_HALF_TURN 512
+#define FIX_QUARTER_TURN 256
+#define FIX_ONE 16384
+
+// Radians to angle units, scaled by 1000: units = rad * FIX_RAD_1000 / 1000
+#define FIX_RAD_1000 162975
+
+void fixInit();
+int16_t fixSin(int angle);
+int16_t fixCos(int angle);
+uint8_t sin8(int angle);
+int fixAtan2(int y, int x);
+uint16_t fixSqrt(uint32_t v);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef FSCACHE_H
+#define FSCACHE_H
+
+#include <Arduino.h>
+#include <time.h>
+
+#define FS_CACHE_MAX 512
+#define FS_CACHE_GROW 32
+#define FS_PATH_MAX 64
+
+struct FsEntry {
+    char path[FS_PATH_MAX];   // absolute
+    uint32_t size;
+    time_t mtime;
+    bool dir;
+};
+
+enum FsSort {
+    FS_SORT_NAME,
+    FS_SORT_SIZE,   // largest first
+    FS_SORT_TIME    // newest first
+};
+
+#define FS_LIST_RECURSIVE 0x01
+#define FS_LIST_REVERSE   0x02
+
+void fsCacheInit();
+void fsCacheInvalidate();
+void fsCacheUpdate(const String& path);
+void fsCacheRemove(const String& path);
+void fsCacheRename(const String& from, const String& to);
+
+// Entries under dir whose name matches pattern (NULL for all), sorted.
+// Returns a malloc'd array the caller frees, or NULL when nothing matches
+// (count 0) or the partition has more than FS_CACHE_MAX entries (count -1);
+// the caller then reads the directories itself.
+FsEntry* fsCacheQuery(const String& dir, const char* pattern, FsSort sort, int flags,
+                      int& count);
+
+bool globMatch(const char* pattern, const char* name);
+
+#endif
@@ -1,9 +1,9 @@
-#ifndef GRAPHER.H
-#define GRAPHER.H
+#ifndef GRAPHER_H
+#define GRAPHER_H
 
 #include <Arduino.h>
 
-bool evaluateWithX(String expression, float xValue, float& result);
 void funcToGraph(String expression, String lineColour);
+void benchGraph(String expression);
 
 #endif
\ No newline at end of file
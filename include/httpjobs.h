@@ -0,0 +1,42 @@
+#ifndef HTTPJOBS_H
+#define HTTPJOBS_H
+
+#include <Arduino.h>
+#include "network.h"
+
+#define CURL_MAX_JOBS 8
+#define CURL_WORKERS 2
+#define CURL_WORKER_STACK 8192
+#define CURL_JOB_INLINE 512      // bodies larger than this spill to a file
+#define CURL_JOB_HEADERS 192
+
+enum CurlJobState {
+    JOB_FREE,
+    JOB_QUEUED,
+    JOB_RUNNING,
+    JOB_DONE,
+    JOB_FAILED
+};
+
+struct CurlJob {
+    int id;
+    CurlJobState state;              // guarded by jobMutex
+    CurlOptions opts;
+
+    int code;
+    uint32_t durationMs;
+    size_t bytes;
+    int length;                       // Content-Length, -1 if not sent
+    bool complete;
+    bool truncated;                   // stopped at CURL_DISPLAY_LIMIT
+    char headers[CURL_JOB_HEADERS];   // "Name: value\n" for each collected header
+    char body[CURL_JOB_INLINE];
+    String spillPath;                 // set once the body is in a file
+    String error;
+};
+
+int curlSubmit(const CurlOptions& opts);
+void listJobs();
+void foregroundJob(int id);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef HTTPPOOL_H
+#define HTTPPOOL_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+
+// Each open TLS connection holds roughly 40 KB of mbedTLS state
+#define HTTP_POOL_SIZE 3
+#define HTTP_POOL_IDLE_MS 30000
+#define HTTP_POOL_SWEEP_MS 10000
+#define HTTP_SWEEP_STACK 4096
+#define HTTP_MAX_REDIRECTS 5
+#define HTTP_BENCH_DEFAULT 100
+
+struct HttpPoolStats {
+    uint32_t requests;
+    uint32_t opened;     // requests that needed a new TCP (and TLS) connection
+    uint32_t reused;     // requests sent on a kept-alive connection
+    uint32_t evicted;    // idle connections closed by the sweep
+};
+
+void httpPoolInit();
+HTTPClient* httpAcquire(const String& url);
+bool httpWasReused(HTTPClient* http);
+void httpRelease(HTTPClient* http, bool reusable);
+bool httpRedirect(HTTPClient*& http, int code, String& url);
+void httpPoolStats(HttpPoolStats& stats);
+void httpPoolShow();
+void httpBench(String url, int count);
+
+#endif
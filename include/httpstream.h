@@ -0,0 +1,41 @@
+#ifndef HTTPSTREAM_H
+#define HTTPSTREAM_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+
+#define HTTP_STREAM_BUF 512
+#define HTTP_STREAM_IDLE_MS 10000
+
+// Called with each piece of body as it arrives; return false to stop.
+typedef bool (*HttpSink)(const uint8_t* data, size_t len, void* ctx);
+
+struct HttpStreamResult {
+    size_t bytes;        // body bytes handed to the sink
+    bool complete;       // whole body was read
+    bool chunked;
+    bool timedOut;
+    uint32_t elapsedMs;
+    uint32_t peakHeap;   // most heap in use above the level at start
+};
+
+// Header names curl and the stream reader need; pass to collectHeaders()
+// before sending the request.
+extern const char* httpStreamHeaders[];
+extern const size_t httpStreamHeaderCount;
+
+bool httpStreamBody(HTTPClient& http, HttpSink sink, void* ctx, size_t limit,
+                    HttpStreamResult& result);
+
+// Sink that prints text line by line through printLine()
+struct PrintSinkState {
+    char line[128];
+    size_t length;
+};
+bool printSink(const uint8_t* data, size_t len, void* ctx);
+void printSinkFlush(PrintSinkState& state);
+
+// Sink that writes to an open fs::File
+bool fileSink(const uint8_t* data, size_t len, void* ctx);
+
+#endif
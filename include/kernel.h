@@ -18,7 +18,6 @@ enum ProcessState {
 struct Process {
     TaskHandle_t handle;
     const char* name;
-    ProcessState state;
     UBaseType_t priority;
     uint32_t createdAt;      
     uint32_t stackSize;
@@ -26,17 +25,24 @@ struct Process {
 };
 
 #define MAX_PROCESSES 16
-#define KERNEL_PRIORITY 3
+#define TASK_SNAPSHOT_SLACK 4
+#define WAIT_RECHECK_MS 1000
+
+#define CPU_SAMPLE_MS 1000
+#define CPU_WINDOW_SAMPLES 5
+
+#define TOP_REFRESH_MS 1000
+#define TOP_COLS 52
 
 
 void kernelInit();
-void kernelScheduler(void *parameter);
 void kernelShutdown();
 
 
 int createProcess(TaskFunction_t function, const char* name, uint32_t stackSize, 
-                  UBaseType_t priority);
+                  UBaseType_t priority, void* param = NULL);
 int killProcess(int pid);
+void exitProcess();
 void listProcesses();
 ProcessState getProcessState(int pid);
 uint32_t getProcessUptime(int pid);
@@ -46,7 +52,9 @@ uint32_t getSystemUptime();
 uint32_t getFreeMem();
 uint32_t getTotalMem();
 float getCPUUsage();
+float getCoreUsage(int core);
 void printSystemStats();
+void topCommand();
 
 
 void signalProcess(int pid, int signal);
@@ -0,0 +1,39 @@
+#ifndef LOGCHAN_H
+#define LOGCHAN_H
+
+#include <Arduino.h>
+#include "filesystem.h"
+
+#define LOG_CHANNELS 6
+#define LOG_BUF_SIZE (4 * FS_PAGE_SIZE)   // flushed when full
+#define LOG_FLUSH_MS 2000                 // oldest buffered byte waits at most this long
+#define LOG_COMMIT_MS 10000               // open handles are closed (committed) this often
+#define LOG_STACK 4096
+
+void logInit();
+
+// Returns a channel for appending to path, opening one if needed, or -1
+// when all channels are taken. Every logOpen() needs its own logClose();
+// the channel is freed by the last one.
+int logOpen(const char* path);
+void logClose(int channel);
+int logFind(const char* path);   // open channel on path, or -1
+
+bool logWrite(int channel, const char* data, size_t length);
+bool logLine(int channel, const char* text);
+
+// Writes buffered data and closes the handle so it is committed on flash.
+// -1 syncs every channel.
+void logSync(int channel = -1);
+
+// Around an unmount: syncs everything, then blocks writers until resumed.
+void logSuspend();
+void logResume();
+
+// For code that is about to read, rewrite, rename or delete a file: any
+// channel on it is synced first. Returns the channel or -1.
+int logSyncPath(const String& path);
+
+void logShow();
+
+#endif
@@ -19,9 +19,19 @@ enum NetworkStatus {
 
 extern NetworkStatus networkStatus;
 
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+#define WIFI_RETRY_MIN_MS 2000
+#define WIFI_RETRY_MAX_MS 60000
+#define WIFI_STALE_EVENT_MS 300
+#define WIFI_GOT_IP_BIT BIT0
+#define WIFI_FAILED_BIT BIT1
+
+void wifiInit();
 void connectWiFi();
+void connectSavedWiFi(String ssid);
+void listWiFiProfiles();
+void forgetWiFiProfile(String ssid);
 void disconnectWiFi();
-void scanWiFi();
 void showNetworkInfo();
 bool isConnected();
 String getLocalIP();
@@ -39,8 +49,12 @@ String getStatusText(int httpCode);
 String formatBytes(int bytes);
 bool isBinaryContent(String contentType);
 
+#define CURL_DISPLAY_LIMIT 1500
+#define CURL_ERROR_LIMIT 300
+
 struct CurlOptions {
     String url;
+    String outFile = "";
     String method = "GET";
     String data = "";
     bool verbose = false;
@@ -60,11 +74,17 @@ struct CurlOptions {
 
 void curlWithOptions(CurlOptions opts);
 
-struct CurlParams {
+#define WGET_STACK 8192
+#define WGET_RETRIES 3
+#define WGET_RETRY_DELAY_MS 2000
+#define WGET_PROGRESS_MS 5000
+
+struct WgetParams {
     String url;
-    bool verbose;
+    String path;
 };
 
-void curlProcess(void* parameter);
+void wgetCommand(String url, String path);
+void wgetProcess(void* parameter);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef PINGMON_H
+#define PINGMON_H
+
+#include <Arduino.h>
+
+#define PINGMON_MAX_HOSTS 6
+#define PINGMON_SAMPLES 64           // ring of recent round-trip times per host
+#define PINGMON_INTERVAL_MS 1000
+#define PINGMON_MIN_INTERVAL_MS 200
+#define PINGMON_TIMEOUT_MS 1000      // capped at the interval
+#define PINGMON_STACK 4096
+#define PINGMON_LOST 0xFFFF
+#define PINGMON_REFRESH_MS 500
+
+bool pingmonStart(int intervalMs, char** hosts, int count);
+void pingmonStop();
+bool pingmonRunning();
+void pingmonShow();
+void pingmonView();
+void pingmonProcess(void* parameter);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHED_MAX_ENTRIES 24
+#define SCHED_TEXT_MAX 64
+#define SCHED_WHEEL_BITS 6                      // 64 slots per level
+#define SCHED_WHEEL_LEVELS 4                    // 1 s .. ~194 days
+#define SCHED_TICK_MS 1000                      // first period; rearm() sets the rest
+#define SCHED_STACK 4096
+#define SCHED_FILE "/alarms.cfg"
+#define SCHED_LOG "/sched.log"              // one line per fired entry
+
+enum SchedKind {
+    SCHED_ALARM,        // once, at the next HH:MM
+    SCHED_TIMER,        // once, after a number of seconds
+    SCHED_CRON_EVERY,   // command every period seconds
+    SCHED_CRON_DAILY    // command every day at HH:MM
+};
+
+void schedulerInit();
+void schedulerLoad();
+void schedulerClockChanged();
+
+int addAlarm(int hour, int minute, const char* message);
+int addTimer(uint32_t seconds);
+int addCron(const char* spec, const char* command);
+bool cancelEntry(int id);
+void listEntries(int kindMask);
+
+#define SCHED_MASK(kind) (1 << (kind))
+#define SCHED_MASK_ALL 0xFF
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include <Arduino.h>
+
+#define TIME_RESYNC_MS 3600000UL     // SNTP poll interval once running
+#define TIME_TRIM_MS 60000           // how often drift compensation is applied
+#define TIME_MIN_DRIFT_SPAN_MS 300000 // shortest sync interval used for a drift estimate
+#define TIME_MAX_DRIFT_PPM 500.0f    // larger estimates are treated as clock steps
+
+struct TimeSyncStatus {
+    bool running;
+    uint32_t syncs;
+    uint32_t lastSyncMs;         // millis() of the last sync
+    int64_t lastOffsetUs;        // local clock minus NTP just before the last sync
+    float driftPpm;              // positive: local clock runs slow
+    bool driftValid;
+    int64_t appliedUs;           // compensation applied since the last sync
+};
+
+void timeSyncInit();
+void timeSyncStart();
+void timeSyncNow();
+void timeSyncStatus(TimeSyncStatus& out);
+bool timeIsSynced();
+
+#endif
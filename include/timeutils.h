@@ -6,19 +6,12 @@
 
 void syncTime();
 String getTime();
+void showTimeVerbose();
 void showCalendar();
 void timerCommand(int seconds);
 void stopwatchCommand();
+void stopwatchLap();
+void stopwatchStop();
 void setAlarm(String timeStr);
-void checkAlarm();
-
-struct Alarm {
-    bool active;
-    int hour;
-    int minute;
-    String message;
-};
-
-extern Alarm systemAlarm;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef TTY_H
+#define TTY_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#define TTY_BAUD 115200
+#define TTY_RX_BUFFER 1024
+#define TTY_LINE_MAX 256
+#define TTY_QUEUE_DEPTH 8
+#define TTY_QUEUE_WAIT_MS 50       // well under the time TTY_RX_BUFFER takes to fill
+#define TTY_BURST_GAP_MS 500
+
+enum TtyEcho {
+    TTY_ECHO_ON,
+    TTY_ECHO_MASK,
+    TTY_ECHO_OFF
+};
+
+struct TtyLine {
+    uint16_t length;
+    char text[TTY_LINE_MAX];
+};
+
+void ttyInit(unsigned long baud);
+bool ttyReadLine(TtyLine& line, TickType_t timeout);
+bool ttyEnterPressed();
+void ttySetEcho(TtyEcho mode);
+bool ttyInject(const char* text);
+void ttyFlush();
+void ttyShowStats();
+
+#endif
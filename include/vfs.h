@@ -0,0 +1,37 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+enum VfsBackend {
+    VFS_NONE,
+    VFS_SPIFFS,
+    VFS_LITTLEFS
+};
+
+// Backend a blank or unreadable partition is formatted with
+#define VFS_FORMAT_BACKEND VFS_LITTLEFS
+// Heap left untouched while fsmigrate holds every file in RAM
+#define VFS_MIGRATE_RESERVE (48 * 1024)
+#define VFS_BENCH_FILES 16
+#define VFS_BENCH_SIZE 4096
+
+bool vfsMount();
+fs::FS& vfs();
+VfsBackend vfsBackend();
+const char* vfsName();
+bool vfsHasDirs();
+size_t vfsTotalBytes();
+size_t vfsUsedBytes();
+
+String vfsPath(String name);
+String vfsCwd();
+bool vfsChdir(String path);
+bool vfsMkdir(String path);
+bool vfsRmdir(String path);
+
+void vfsMigrate();
+void vfsBench();
+
+#endif
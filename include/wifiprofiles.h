@@ -0,0 +1,23 @@
+#ifndef WIFIPROFILES_H
+#define WIFIPROFILES_H
+
+#include <Arduino.h>
+
+#define WIFI_MAX_PROFILES 4
+#define WIFI_PREFS_NAMESPACE "wifi"
+
+struct WifiProfile {
+    char ssid[33];
+    char pass[65];
+    uint8_t bssid[6];        // AP last associated with, for a scan-free connect
+    uint8_t channel;         // 0 until the profile has connected once
+    uint32_t lastUsed;       // ordering stamp, higher is more recent
+};
+
+// Fills out[] most recently used first and returns the count.
+int loadProfiles(WifiProfile* out);
+bool findProfile(const char* ssid, WifiProfile& out);
+bool saveProfile(const WifiProfile& profile);
+bool forgetProfile(const char* ssid);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef WIFISCAN_H
+#define WIFISCAN_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define SCAN_MAX_RESULTS 32
+#define SCAN_FRESH_MS 15000       // cached results younger than this are not refreshed
+#define SCAN_TIMEOUT_MS 10000
+#define SCAN_POLL_MS 100
+#define SCAN_STACK 4096
+
+struct ScanEntry {
+    char ssid[33];
+    uint8_t bssid[6];
+    int8_t rssi;
+    uint8_t channel;
+    wifi_auth_mode_t encryption;
+};
+
+enum ScanSort {
+    SCAN_SORT_RSSI,
+    SCAN_SORT_CHANNEL,
+    SCAN_SORT_SSID
+};
+
+struct ScanFilter {
+    ScanSort sort = SCAN_SORT_RSSI;
+    int channel = 0;              // 0 = all
+    int minRssi = -128;
+};
+
+void scanWiFi(const ScanFilter& filter, bool wait);
+void scanChannels();
+bool scanRefresh();
+
+#endif
@@ -31,6 +31,9 @@
 #endif
 #endif
 #include <SPI.h>
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
 
 #define SPI_DEFAULT_FREQ 32000000 ///< Default SPI data clock frequency
 
@@ -250,6 +253,152 @@ void Adafruit_ST77xx::enableSleep(boolean enable) {
   sendCommand(enable ? ST77XX_SLPIN : ST77XX_SLPOUT);
 }
 
+#if defined(ESP32)
+/**************************************************************************/
+/*!
+ @brief  Set up the band pipeline: pixel buffers in DMA-capable memory and
+         a transfer task on ST77XX_BAND_CORE that clocks queued bands out
+         while the caller renders the next one into another buffer.
+ @param  maxPixels  Capacity of each buffer in pixels
+ @param  count      Number of buffers, 2 to ST77XX_MAX_BANDS
+ @return true on success, false if memory or the task could not be created
+ */
+/**************************************************************************/
+bool Adafruit_ST77xx::initBandPipeline(uint32_t maxPixels, uint8_t count) {
+  if (_bandCount)
+    return true;
+  if (count < 2)
+    count = 2;
+  if (count > ST77XX_MAX_BANDS)
+    count = ST77XX_MAX_BANDS;
+
+  _bandFree = xQueueCreate(count, sizeof(uint16_t *));
+  _bandWork = xQueueCreate(count, sizeof(BandJob));
+  if (!_bandFree || !_bandWork) {
+    freeBandPipeline();
+    return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint16_t *buf = (uint16_t *)heap_caps_malloc(maxPixels * 2, MALLOC_CAP_DMA);
+    if (!buf)
+      break;
+    xQueueSend(_bandFree, &buf, 0);
+    _bandCount++;
+  }
+  if (_bandCount < 2 ||
+      xTaskCreatePinnedToCore(bandTask, "tftband", ST77XX_BAND_STACK, this,
+                              ST77XX_BAND_PRIORITY, &_bandTaskHandle,
+                              ST77XX_BAND_CORE) != pdPASS) {
+    freeBandPipeline();
+    return false;
+  }
+
+  // Only now is the pipeline usable; callers test bandMaxPixels()
+  _bandMaxPixels = maxPixels;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+ @brief  Release whatever a failed initBandPipeline() allocated, leaving
+         the pipeline off
+ */
+/**************************************************************************/
+void Adafruit_ST77xx::freeBandPipeline(void) {
+  uint16_t *buf;
+  if (_bandFree) {
+    while (xQueueReceive(_bandFree, &buf, 0) == pdTRUE)
+      heap_caps_free(buf);
+    vQueueDelete(_bandFree);
+  }
+  if (_bandWork)
+    vQueueDelete(_bandWork);
+  _bandFree = NULL;
+  _bandWork = NULL;
+  _bandTaskHandle = NULL;
+  _bandCount = 0;
+  _bandMaxPixels = 0;
+}
+
+/**************************************************************************/
+/*!
+ @brief  Take a free band buffer, waiting for an in-flight band to finish
+         if all of them are queued
+ @return Buffer of bandMaxPixels() pixels, or NULL if the pipeline is off
+ */
+/**************************************************************************/
+uint16_t *Adafruit_ST77xx::getBandBuffer(void) {
+  uint16_t *buf = NULL;
+  if (_bandCount)
+    xQueueReceive(_bandFree, &buf, portMAX_DELAY);
+  return buf;
+}
+
+/**************************************************************************/
+/*!
+ @brief  Queue a buffer from getBandBuffer() for transfer and return at
+         once. The buffer goes back to the free list when it has been sent.
+ @param  x       Top left corner x coordinate
+ @param  y       Top left corner y coordinate
+ @param  w       Width of band
+ @param  h       Height of band
+ @param  pixels  Buffer holding w*h pixels in native (little-endian) order
+ */
+/**************************************************************************/
+void Adafruit_ST77xx::pushBand(uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                               uint16_t *pixels) {
+  BandJob job = {x, y, w, h, pixels};
+  xQueueSend(_bandWork, &job, portMAX_DELAY);
+}
+
+/**************************************************************************/
+/*!
+ @brief  Block until every queued band has been clocked out. Call before
+         drawing through the regular GFX functions again.
+ */
+/**************************************************************************/
+void Adafruit_ST77xx::waitIdle(void) {
+  uint16_t *held[ST77XX_MAX_BANDS];
+  for (uint8_t i = 0; i < _bandCount; i++)
+    xQueueReceive(_bandFree, &held[i], portMAX_DELAY);
+  for (uint8_t i = 0; i < _bandCount; i++)
+    xQueueSend(_bandFree, &held[i], 0);
+}
+
+/**************************************************************************/
+/*!
+ @brief  Total time the transfer task has spent sending bands
+ @return Microseconds, wrapping at 2^32
+ */
+/**************************************************************************/
+uint32_t Adafruit_ST77xx::bandBusyMicros(void) { return _bandBusyUs; }
+
+/**************************************************************************/
+/*!
+ @brief  Transfer task body: sends queued bands one after another
+ @param  arg  The owning Adafruit_ST77xx
+ */
+/**************************************************************************/
+void Adafruit_ST77xx::bandTask(void *arg) {
+  Adafruit_ST77xx *tft = (Adafruit_ST77xx *)arg;
+  BandJob job;
+
+  for (;;) {
+    xQueueReceive(tft->_bandWork, &job, portMAX_DELAY);
+
+    uint32_t start = micros();
+    tft->startWrite();
+    tft->setAddrWindow(job.x, job.y, job.w, job.h);
+    tft->writePixels(job.pixels, (uint32_t)job.w * job.h);
+    tft->endWrite();
+    tft->_bandBusyUs += micros() - start;
+
+    xQueueSend(tft->_bandFree, &job.pixels, portMAX_DELAY);
+  }
+}
+#endif // ESP32
+
 ////////// stuff not actively being used, but kept for posterity
 /*
 
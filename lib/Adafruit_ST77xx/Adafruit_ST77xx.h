@@ -31,6 +31,17 @@
 #include <Adafruit_SPITFT.h>
 #include <Adafruit_SPITFT_Macros.h>
 
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#define ST77XX_MAX_BANDS 4       ///< Upper limit on band pipeline buffers
+#define ST77XX_BAND_CORE 0       ///< Core the band transfer task runs on
+#define ST77XX_BAND_PRIORITY 3   ///< Priority of the band transfer task
+#define ST77XX_BAND_STACK 2048   ///< Stack size of the band transfer task
+#endif
+
 #define ST7735_TFTWIDTH_128 128  // for 1.44 and mini
 #define ST7735_TFTWIDTH_80 80    // for mini
 #define ST7735_TFTHEIGHT_128 128 // for 1.44" display
@@ -103,6 +114,16 @@ public:
   void enableTearing(boolean enable);
   void enableSleep(boolean enable);
 
+#if defined(ESP32)
+  bool initBandPipeline(uint32_t maxPixels, uint8_t count = 2);
+  uint16_t *getBandBuffer(void);
+  void pushBand(uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                uint16_t *pixels);
+  void waitIdle(void);
+  uint32_t bandBusyMicros(void);
+  uint32_t bandMaxPixels(void) { return _bandMaxPixels; } ///< Band capacity
+#endif
+
 protected:
   uint8_t _colstart = 0,   ///< Some displays need this changed to offset
       _rowstart = 0,       ///< Some displays need this changed to offset
@@ -112,6 +133,25 @@ protected:
   void commonInit(const uint8_t *cmdList);
   void displayInit(const uint8_t *addr);
   void setColRowStart(int8_t col, int8_t row);
+
+#if defined(ESP32)
+private:
+  /// One queued band transfer
+  struct BandJob {
+    uint16_t x, y, w, h; ///< Address window
+    uint16_t *pixels;    ///< Pixel data, w*h entries
+  };
+
+  static void bandTask(void *arg);
+  void freeBandPipeline(void);
+
+  QueueHandle_t _bandFree = NULL;     ///< Buffers ready for rendering
+  QueueHandle_t _bandWork = NULL;     ///< Bands waiting to be clocked out
+  TaskHandle_t _bandTaskHandle = NULL;
+  uint8_t _bandCount = 0;             ///< Buffers owned by the pipeline
+  uint32_t _bandMaxPixels = 0;        ///< Capacity of each buffer
+  volatile uint32_t _bandBusyUs = 0;  ///< Total time spent transferring
+#endif
 };
 
 #endif // _ADAFRUIT_ST77XXH_
@@ -1,6 +1,9 @@
 #include "commands.h"
 #include "display.h"
 #include "filesystem.h"
+#include "filereader.h"
+#include "vfs.h"
+#include "logchan.h"
 #include "network.h"
 #include "theme.h"
 #include "config.h"
@@ -8,15 +11,21 @@
 #include "timeutils.h"
 #include "kernel.h"
 #include "grapher.h"
+#include "expr.h"
+#include "tty.h"
+#include "console.h"
+#include "httppool.h"
+#include "httpjobs.h"
+#include "pingmon.h"
+#include "wifiscan.h"
+#include "scheduler.h"
 #include <esp_system.h>
 #include <WiFi.h>
 #include <math.h>
 
-#define PI 3.14159265358979323846
-#define E  2.71828182845904523536
 #define HISTORY_SIZE 10  
 const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-String commandHistory[HISTORY_SIZE];
+char commandHistory[HISTORY_SIZE][TTY_LINE_MAX];
 int historyIndex = 0;
 int historyCount = 0;
 
@@ -30,10 +39,11 @@ void showVersion() {
 }
 
 
-void addToHistory(String cmd) {
-    if (cmd.length() == 0) return;
-    if (historyCount > 0 && commandHistory[(historyIndex - 1 + HISTORY_SIZE) % HISTORY_SIZE] == cmd) return;
-    commandHistory[historyIndex] = cmd;
+void addToHistory(const char* cmd) {
+    if (cmd[0] == '\0') return;
+    if (historyCount > 0 && strcmp(commandHistory[(historyIndex - 1 + HISTORY_SIZE) % HISTORY_SIZE], cmd) == 0) return;
+    strncpy(commandHistory[historyIndex], cmd, TTY_LINE_MAX - 1);
+    commandHistory[historyIndex][TTY_LINE_MAX - 1] = '\0';
     historyIndex = (historyIndex + 1) % HISTORY_SIZE;
     if (historyCount < HISTORY_SIZE) historyCount++;
 }
@@ -151,281 +161,22 @@ void base64Command(String operation, String text) {
 }
 
 
-void showHelp() {
-    printLine("MiniOS Command Help");
-    printLine("");
-    printLine("  help file     - File commands");
-    printLine("  help system   - System commands");
-    printLine("  help network  - Network commands");
-    printLine("  help utils    - Utility commands");
-    printLine("  help time     - Time commands");
-    printLine("  help display  - Display commands");
-    printLine("  help os       - OS management");
-}
-
-void showHelpFile() {
-    printLine("File Commands:");
-    printLine("  write <file> <text>   - Write text");
-    printLine("  append <file> <text>  - Append text");
-    printLine("  read <file>           - Read file");
-    printLine("  delete <file>         - Delete file (alias: rm)");
-    printLine("  ls                    - List files (alias: dir)");
-    printLine("  mv <old> <new>        - Rename file (alias: rename)");
-    printLine("  cp <src> <dst>        - Copy file (alias: copy)");
-}
-
-void showHelpSystem() {
-    printLine("System Commands:");
-    printLine("  mem       - Memory info (alias: free)");
-    printLine("  uptime    - System uptime");
-    printLine("  reboot    - Restart device (alias: restart)");
-    printLine("  fetch     - System info (alias: neofetch)");
-    printLine("  os        - OS logo (alias: logo)");
-    printLine("  version   - OS version (alias: ver)");
-    printLine("  clear     - Clear display (alias: cls)");
-    printLine("  history   - Command history (alias: hist)");
-}
-
-void showHelpNetwork() {
-    printLine("Network Commands:");
-    printLine("  wifi              - Connect to WiFi");
-    printLine("  disconnect        - Disconnect WiFi");
-    printLine("  scanwifi          - Scan networks");
-    printLine("  ifconfig          - Network info");
-    printLine("  ping <host>       - Ping host");
-    printLine("  nslookup <host>   - DNS lookup");
-    printLine("  curl <url>        - Fetch URL");
-    printLine("  curl -v <url>     - Verbose mode");
-}
-
-void showHelpUtils() {
-    printLine("Utility Commands:");
-    printLine("  calc <expr>                 - Calculator");
-    printLine("  hex <number>                - Dec to hex");
-    printLine("  bin <number>                - Dec to bin");
-    printLine("  base64 encode <text>        - Encode Base64");
-    printLine("  base64 decode <text>        - Decode Base64");
-    printLine("  graph <expression> <colour> - Graph function");
-    printLine("  echo <text>                 - Print text");
-}
-
-void showHelpTime() {
-    printLine("Time Commands:");
-    printLine("  time            - Current time");
-    printLine("  synctime        - Sync with NTP");
-    printLine("  calendar        - Show calendar");
-    printLine("  timer <sec>     - Countdown timer");
-    printLine("  stopwatch       - Elapsed timer");
-    printLine("  alarm <HH:MM>   - Set alarm");
-}
-
-void showHelpOS() {
-    printLine("OS Commands:");
-    printLine("  ps / processes - List processes");
-    printLine("  sysstat / stat - System stats");
-    printLine("  kill <pid>     - Kill process");
-}
-
-void showHelpDisplay() {
-    printLine("Display Commands:");
-    printLine("  themes          - List themes");
-    printLine("  theme <n>       - Select theme");
-    printLine("  screensaver <n> - Run screensaver");
-    printLine("  pug             - Show pug image");
-}
-
-
-int precedence(char op) {
-    if (op == '+' || op == '-') return 1;
-    if (op == '*' || op == '/' || op == '%') return 2;
-    if (op == '^') return 3;
-    return 0;
-}
-
-bool isRightAssociative(char op) {
-    return (op == '^');
-}
-
-float applyOp(float a, float b, char op) {
-    switch (op) {
-        case '+': return a + b;
-        case '-': return a - b;
-        case '*': return a * b;
-        case '/': 
-            if (b == 0) {
-                printLine("Error: Division by zero");
-                return 0;
-            }
-            return a / b;
-        case '%': 
-            if (b == 0) {
-                printLine("Error: Modulo by zero");
-                return 0;
-            }
-            return (int)a % (int)b;
-        case '^': return pow(a, b);
-    }
-    return 0;
-}
-
-bool isFunction(const String& expr, int pos, const String& func) {
-    int len = func.length();
-    if (pos + len > expr.length()) return false;
-    return expr.substring(pos, pos + len).equalsIgnoreCase(func);
-}
-
-String getFunctionName(const String& expr, int pos) {
-    String functions[] = {
-        "sqrt", "sin", "cos", "tan", "asin", "acos", "atan",
-        "sinh", "cosh", "tanh", "log", "ln", "exp",
-        "abs", "ceil", "floor", "round"
-    };
-    for (int i = 0; i < 17; i++) {
-        if (isFunction(expr, pos, functions[i])) {
-            return functions[i];
-        }
-    }
-    return "";
-}
-
-float applyFunction(const String& func, float value) {
-    if (func == "sqrt") return sqrt(value);
-    if (func == "sin") return sin(value);
-    if (func == "cos") return cos(value);
-    if (func == "tan") return tan(value);
-    if (func == "asin") return asin(value);
-    if (func == "acos") return acos(value);
-    if (func == "atan") return atan(value);
-    if (func == "sinh") return sinh(value);
-    if (func == "cosh") return cosh(value);
-    if (func == "tanh") return tanh(value);
-    if (func == "log") return log10(value);
-    if (func == "ln") return log(value);
-    if (func == "exp") return exp(value);
-    if (func == "abs") return abs(value);
-    if (func == "ceil") return ceil(value);
-    if (func == "floor") return floor(value);
-    if (func == "round") return round(value);
-    return value;
-}
-
 void calc(String expression) {
-    expression.replace(" ", "");
-    expression.replace("pi", String(PI, 10));
-    expression.replace("e", String(E, 10));
-    
-    if (expression.length() == 0) {
-        printLine("Error: Empty expression");
+    ExprProgram program;
+    String error;
+
+    if (!compileExpression(expression.c_str(), false, program, error)) {
+        printLine("Error: " + error);
         return;
     }
-    
-    float values[50];
-    char ops[50];
-    String functions[50];
-    int vTop = -1;
-    int oTop = -1;
-    int fTop = -1;
-    
-    int n = expression.length();
-    
-    for (int i = 0; i < n; i++) {
-        String funcName = getFunctionName(expression, i);
-        if (funcName.length() > 0) {
-            i += funcName.length();
-            functions[++fTop] = funcName;
-            continue;
-        }
-        
-        if (expression[i] == '(') {
-            ops[++oTop] = '(';
-        }
-        else if (expression[i] == ')') {
-            while (oTop >= 0 && ops[oTop] != '(') {
-                float b = values[vTop--];
-                float a = values[vTop--];
-                char op = ops[oTop--];
-                values[++vTop] = applyOp(a, b, op);
-            }
-            if (oTop >= 0) oTop--;
-            
-            if (fTop >= 0) {
-                float val = values[vTop--];
-                val = applyFunction(functions[fTop--], val);
-                values[++vTop] = val;
-            }
-        }
-        else if (isdigit(expression[i]) || expression[i] == '.') {
-            float num = 0;
-            float decimal = 0;
-            bool hasDecimal = false;
-            int decimalPlaces = 0;
-            
-            while (i < n && (isdigit(expression[i]) || expression[i] == '.')) {
-                if (expression[i] == '.') {
-                    hasDecimal = true;
-                } else {
-                    if (hasDecimal) {
-                        decimal = decimal * 10 + (expression[i] - '0');
-                        decimalPlaces++;
-                    } else {
-                        num = num * 10 + (expression[i] - '0');
-                    }
-                }
-                i++;
-            }
-            i--;
-            
-            if (hasDecimal && decimalPlaces > 0) {
-                num += decimal / pow(10, decimalPlaces);
-            }
-            
-            values[++vTop] = num;
-        }
-        else if (expression[i] == '-' && 
-                (i == 0 || expression[i-1] == '(' || expression[i-1] == '+' || 
-                 expression[i-1] == '-' || expression[i-1] == '*' || 
-                 expression[i-1] == '/' || expression[i-1] == '^')) {
-            values[++vTop] = 0;
-            ops[++oTop] = '-';
-        }
-        else if (expression[i] == '+' || expression[i] == '-' || 
-                 expression[i] == '*' || expression[i] == '/' || 
-                 expression[i] == '%' || expression[i] == '^') {
-            while (oTop >= 0 && ops[oTop] != '(' && 
-                   (precedence(ops[oTop]) > precedence(expression[i]) ||
-                    (precedence(ops[oTop]) == precedence(expression[i]) && 
-                     !isRightAssociative(expression[i])))) {
-                float b = values[vTop--];
-                float a = values[vTop--];
-                char op = ops[oTop--];
-                values[++vTop] = applyOp(a, b, op);
-            }
-            ops[++oTop] = expression[i];
-        }
-        else {
-            printLine("Error: Invalid character '" + String(expression[i]) + "'");
-            return;
-        }
-    }
-    
-    while (oTop >= 0) {
-        if (ops[oTop] == '(') {
-            printLine("Error: Mismatched parentheses");
-            return;
-        }
-        float b = values[vTop--];
-        float a = values[vTop--];
-        char op = ops[oTop--];
-        values[++vTop] = applyOp(a, b, op);
-    }
-    
-    if (vTop != 0) {
-        printLine("Error: Invalid expression");
+
+    float result;
+    ExprStatus status = runExpression(program, 0, result);
+    if (status != EXPR_OK) {
+        printLine("Error: " + String(exprStatusText(status)));
         return;
     }
     
-    float result = values[vTop];
-    
     if (result == (int)result && abs(result) < 1000000) {
         printLine("Result: " + String((int)result));
     } else {
@@ -505,8 +256,8 @@ void fetch() {
     
     printLine("");
     
-    int startX = 5;
-    int startY = tft.getCursorY() + 5; 
+    int startX = CONSOLE_X;
+    int startY = consoleReserve(4) + 5;
     int blockWidth = 15;
     int blockHeight = 10;
 
@@ -519,9 +270,6 @@ void fetch() {
     for (int i=0;i<8;i++) tft.fillRect(startX + i*blockWidth, startY, blockWidth, blockHeight, colors2[i]);
 
     
-    startY += blockHeight;
-    tft.setCursor(startX, startY + 5);
-    currentCursorY = startY; 
 
 
     }
@@ -531,346 +279,688 @@ void echoCommand(String text) {
 }
 
 
-struct CommandArgs {
-    String cmd;
-    String arg1;
-    String arg2;
-    String rest;
+// Command table. Every command is described once by a Command entry; the
+// shell keeps a sorted index of names and aliases and finds a command with
+// a case-insensitive binary search. Arguments are split in place over the
+// input line, so nothing is copied until a handler asks for a String.
+
+struct CommandKey {
+    const char* text;
+    uint8_t length;
+    const Command* command;
 };
 
-CommandArgs parseCommand(String input) {
-    CommandArgs args;
-    input.trim();
-    
-    int firstSpace = input.indexOf(' ');
-    if (firstSpace == -1) {
-        args.cmd = input;
-        return args;
+struct HelpGroup {
+    const char* name;
+    const char* title;
+};
+
+static const HelpGroup helpGroups[] = {
+    {"file",    "File commands"},
+    {"system",  "System commands"},
+    {"network", "Network commands"},
+    {"utils",   "Utility commands"},
+    {"time",    "Time commands"},
+    {"display", "Display commands"},
+    {"os",      "OS management"},
+};
+#define HELP_GROUP_COUNT (sizeof(helpGroups) / sizeof(helpGroups[0]))
+
+static CommandKey commandIndex[MAX_COMMAND_KEYS];
+static int commandKeyCount = 0;
+static const Command* commandTables[MAX_COMMAND_TABLES];
+static int commandTableSizes[MAX_COMMAND_TABLES];
+static int commandTableCount = 0;
+
+static int compareKey(const char* a, int alen, const char* b, int blen) {
+    int n = alen < blen ? alen : blen;
+    int r = strncasecmp(a, b, n);
+    if (r != 0) return r;
+    return alen - blen;
+}
+
+static int findKey(const char* text, int length, bool& found) {
+    int lo = 0;
+    int hi = commandKeyCount;
+    found = false;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int r = compareKey(text, length, commandIndex[mid].text, commandIndex[mid].length);
+        if (r == 0) {
+            found = true;
+            return mid;
+        }
+        if (r < 0) hi = mid;
+        else lo = mid + 1;
     }
-    
-    args.cmd = input.substring(0, firstSpace);
-    String remainder = input.substring(firstSpace + 1);
-    remainder.trim();
-    
-    int secondSpace = remainder.indexOf(' ');
-    if (secondSpace == -1) {
-        args.arg1 = remainder;
-        return args;
+    return lo;
+}
+
+static bool addKey(const char* text, int length, const Command* command) {
+    bool found;
+    int pos = findKey(text, length, found);
+
+    if (found) {
+        Serial.printf("[SHELL] Duplicate command name: %.*s\n", length, text);
+        return false;
     }
-    
-    args.arg1 = remainder.substring(0, secondSpace);
-    args.rest = remainder.substring(secondSpace + 1);
-    args.rest.trim();
-    
-    int thirdSpace = args.rest.indexOf(' ');
-    if (thirdSpace != -1) {
-        args.arg2 = args.rest.substring(0, thirdSpace);
-        args.rest = args.rest.substring(thirdSpace + 1);
-        args.rest.trim();
-    } else if (args.rest.length() > 0) {
-        args.arg2 = args.rest;
-        args.rest = "";
+    if (commandKeyCount >= MAX_COMMAND_KEYS) {
+        Serial.println("[SHELL] Command index full");
+        return false;
     }
-    
-    return args;
+
+    memmove(&commandIndex[pos + 1], &commandIndex[pos],
+            (commandKeyCount - pos) * sizeof(CommandKey));
+    commandIndex[pos].text = text;
+    commandIndex[pos].length = length;
+    commandIndex[pos].command = command;
+    commandKeyCount++;
+    return true;
 }
 
-void runCommand(String cmd) {
-    cmd.trim();
-    
-    if (cmd.length() == 0){
-        if(currentCursorY>=MAX_Y){
-            clearScreen();
-            tft.print("> ");
-        }
-        return;
+bool registerCommands(const Command* commands, int count) {
+    if (commandTableCount >= MAX_COMMAND_TABLES) {
+        Serial.println("[SHELL] Too many command tables");
+        return false;
     }
-    
-    addToHistory(cmd);
-    
-    CommandArgs args = parseCommand(cmd);
-    String baseCmd = args.cmd;
-    baseCmd.toLowerCase();
-    
-    if (baseCmd == "write") {
-        if (args.arg1.length() == 0 || args.rest.length() == 0) {
-            printLine("Usage: write <filename> <text>");
-            return;
+
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        const Command* cmd = &commands[i];
+        ok &= addKey(cmd->name, strlen(cmd->name), cmd);
+
+        const char* p = cmd->aliases;
+        while (p && *p) {
+            while (*p == ' ') p++;
+            const char* start = p;
+            while (*p && *p != ' ') p++;
+            if (p > start) ok &= addKey(start, p - start, cmd);
         }
-        writeFile(args.arg1, args.rest);
     }
-    else if (baseCmd == "append") {
-        if (args.arg1.length() == 0 || args.rest.length() == 0) {
-            printLine("Usage: append <filename> <text>");
-            return;
-        }
-        appendFile(args.arg1, args.rest);
+
+    commandTables[commandTableCount] = commands;
+    commandTableSizes[commandTableCount] = count;
+    commandTableCount++;
+    return ok;
+}
+
+const Command* findCommand(const char* name) {
+    bool found;
+    int pos = findKey(name, strlen(name), found);
+    return found ? commandIndex[pos].command : NULL;
+}
+
+static char* skipSpaces(char* p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+static char* cutToken(char* p) {
+    while (*p && *p != ' ' && *p != '\t') p++;
+    if (*p) *p++ = '\0';
+    return p;
+}
+
+static void trimRight(char* s) {
+    int n = strlen(s);
+    while (n > 0 && (s[n - 1] == ' ' || s[n - 1] == '\t')) s[--n] = '\0';
+}
+
+static void printUsage(const Command* cmd) {
+    printLine("Usage: " + String(cmd->usage));
+}
+
+void runCommand(char* line) {
+    char* p = skipSpaces(line);
+    trimRight(p);
+
+    if (*p == '\0') return;
+
+    addToHistory(p);
+
+    char* argv[CMD_MAX_ARGS + 1];
+    int argc = 0;
+    argv[argc++] = p;
+    p = cutToken(p);
+
+    const Command* cmd = findCommand(argv[0]);
+    if (cmd == NULL) {
+        printLine("Unknown command: " + String(argv[0]));
+        printLine("Type 'help' for available commands");
+        return;
     }
-    else if (baseCmd == "read") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: read <filename>");
+
+    while (*(p = skipSpaces(p))) {
+        if (argc > cmd->maxArgs) {
+            printUsage(cmd);
             return;
         }
-        readFile(args.arg1);
+        argv[argc++] = p;
+        if ((cmd->flags & CMD_REST) && argc == cmd->maxArgs + 1) break;
+        p = cutToken(p);
     }
-    else if (baseCmd == "delete" || baseCmd == "rm") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: delete <filename>");
-            return;
-        }
-        deleteFile(args.arg1);
+    argv[argc] = NULL;
+
+    if (argc - 1 < cmd->minArgs) {
+        printUsage(cmd);
+        return;
+    }
+
+    cmd->handler(argc, argv);
+}
+
+
+static void helpLine(const Command* cmd) {
+    char line[96];
+
+    if (cmd->aliases && cmd->aliases[0]) {
+        snprintf(line, sizeof(line), "  %-24s - %s (alias: %s)", cmd->usage, cmd->help, cmd->aliases);
+    } else {
+        snprintf(line, sizeof(line), "  %-24s - %s", cmd->usage, cmd->help);
     }
-    else if (baseCmd == "ls" || baseCmd == "dir") {
-        listFiles();
+    printLine(line);
+}
+
+void showHelp() {
+    char line[80];
+
+    printLine("MiniOS Command Help");
+    printLine("");
+    for (unsigned g = 0; g < HELP_GROUP_COUNT; g++) {
+        sprintf(line, "  help %-8s - %s", helpGroups[g].name, helpGroups[g].title);
+        printLine(line);
     }
-    else if (baseCmd == "mv" || baseCmd == "rename") {
-        if (args.arg1.length() == 0 || args.arg2.length() == 0) {
-            printLine("Usage: mv <old> <new>");
-            return;
-        }
-        renameFile(args.arg1, args.arg2);
+    printLine("  help <command> - Usage of one command");
+}
+
+static bool showHelpGroup(const char* group) {
+    const HelpGroup* match = NULL;
+    for (unsigned g = 0; g < HELP_GROUP_COUNT; g++) {
+        if (strcasecmp(helpGroups[g].name, group) == 0) match = &helpGroups[g];
     }
-    else if (baseCmd == "cp" || baseCmd == "copy") {
-        if (args.arg1.length() == 0 || args.arg2.length() == 0) {
-            printLine("Usage: cp <src> <dst>");
-            return;
+    if (match == NULL) return false;
+
+    printLine(String(match->title) + ":");
+    for (int t = 0; t < commandTableCount; t++) {
+        for (int i = 0; i < commandTableSizes[t]; i++) {
+            const Command* cmd = &commandTables[t][i];
+            if (strcmp(cmd->group, match->name) == 0) helpLine(cmd);
         }
-        copyFile(args.arg1, args.arg2);
     }
-    else if (baseCmd == "wifi") {
-        if (args.arg1 == "disconnect") {
-            disconnectWiFi();
-        } else {
-            connectWiFi();
-        }
+    return true;
+}
+
+static void showHelpTopic(const char* topic) {
+    if (showHelpGroup(topic)) return;
+
+    const Command* cmd = findCommand(topic);
+    if (cmd == NULL) {
+        printLine("Unknown help topic: " + String(topic));
+        showHelp();
+        return;
     }
-    else if (baseCmd == "disconnect") {
-        disconnectWiFi();
+
+    printLine("Usage: " + String(cmd->usage));
+    printLine("  " + String(cmd->help));
+    if (cmd->aliases && cmd->aliases[0]) {
+        printLine("  Aliases: " + String(cmd->aliases));
     }
-    else if (baseCmd == "scanwifi" || baseCmd == "wifiscan") {
-        scanWiFi();
+}
+
+
+static void cmdWrite(int argc, char** argv)    { writeFile(argv[1], argv[2]); }
+static void cmdAppend(int argc, char** argv)   { appendFile(argv[1], argv[2]); }
+static void cmdRead(int argc, char** argv) {
+    if (argc == 2) {
+        readFile(argv[1]);
+    } else if (argc == 4) {
+        readRange(argv[1], strtoul(argv[2], NULL, 0), strtoul(argv[3], NULL, 0));
+    } else {
+        printLine("Usage: read <file> [offset length]");
+    }
+}
+
+// head/tail take "<file>", "-n N <file>" or "-N <file>".
+static void fileLinesCommand(int argc, char** argv, void (*show)(String, int)) {
+    int lines = FILE_TAIL_DEFAULT;
+    int arg = 1;
+    if (argc == 4 && strcmp(argv[1], "-n") == 0) {
+        lines = atoi(argv[2]);
+        arg = 3;
+    } else if (argc == 3 && argv[1][0] == '-') {
+        lines = atoi(argv[1] + 1);
+        arg = 2;
+    } else if (argc != 2) {
+        printLine("Usage: " + String(argv[0]) + " [-n N] <file>");
+        return;
     }
-    else if (baseCmd == "ifconfig" || baseCmd == "netinfo" || baseCmd == "ipconfig") {
-        showNetworkInfo();
+    if (lines <= 0) {
+        printLine("Invalid line count");
+        return;
     }
-    else if (baseCmd == "curl") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: curl [-v] <url>");
-            return;
+    show(argv[arg], lines);
+}
+
+static void cmdMkdir(int argc, char** argv) {
+    if (!vfsHasDirs()) printLine("mkdir: " + String(vfsName()) + " has no directories (see fsmigrate)");
+    else if (!vfsMkdir(argv[1])) printLine("mkdir: cannot create " + vfsPath(argv[1]));
+}
+
+static void cmdRmdir(int argc, char** argv) {
+    if (!vfsRmdir(argv[1])) printLine("rmdir: cannot remove " + vfsPath(argv[1]) + " (missing, not empty or in use)");
+}
+
+static void cmdCd(int argc, char** argv) {
+    if (!vfsChdir(argc > 1 ? argv[1] : "/")) printLine("cd: no such directory: " + vfsPath(argv[1]));
+}
+
+static void cmdPwd(int argc, char** argv)       { printLine(vfsCwd()); }
+static void cmdFsMigrate(int argc, char** argv) { vfsMigrate(); }
+static void cmdFsBench(int argc, char** argv)   { vfsBench(); }
+
+static void cmdHead(int argc, char** argv)     { fileLinesCommand(argc, argv, headFile); }
+static void cmdTail(int argc, char** argv)     { fileLinesCommand(argc, argv, tailFile); }
+static void cmdMore(int argc, char** argv)     { moreFile(argv[1]); }
+static void cmdReadBench(int argc, char** argv) { readBench(argv[1]); }
+static void cmdDelete(int argc, char** argv)   { deleteFile(argv[1]); }
+static void cmdLs(int argc, char** argv) {
+    FsSort sort = FS_SORT_NAME;
+    int flags = 0;
+    String target = "";
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            target = argv[i];
+            continue;
         }
-        
-        if (args.arg1 == "-v") {
-            if (args.rest.length() == 0) {
-                printLine("Usage: curl -v <url>");
+        for (const char* c = argv[i] + 1; *c; c++) {
+            if (*c == 'S') sort = FS_SORT_SIZE;
+            else if (*c == 't') sort = FS_SORT_TIME;
+            else if (*c == 'r') flags |= FS_LIST_REVERSE;
+            else {
+                printLine("Usage: ls [-S|-t] [-r] [dir|pattern]");
                 return;
             }
-            curlURLVerbose(args.rest);
-        } else {
-            curlURL(args.arg1 + (args.rest.length() > 0 ? " " + args.rest : ""));
         }
     }
-    else if (baseCmd == "ping") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: ping <host>");
+    listFiles(target, sort, flags);
+}
+
+static void cmdFind(int argc, char** argv)     { findFiles(argv[1]); }
+
+static void cmdSync(int argc, char** argv) {
+    logSync();
+    printLine("Synced.");
+}
+
+// Channels the log command holds, one use each, until "log -c".
+static bool shellLogs[LOG_CHANNELS];
+
+static void cmdLog(int argc, char** argv) {
+    if (argc == 1) {
+        logShow();
+        return;
+    }
+    if (argc < 3) {
+        printLine("Usage: log [-c] <file> <text>");
+        return;
+    }
+    if (strcmp(argv[1], "-c") == 0) {
+        int channel = logFind(argv[2]);
+        if (channel < 0 || !shellLogs[channel]) {
+            printLine("log: no channel opened by log on " + String(argv[2]));
             return;
         }
-        pingHost(args.arg1);
+        logClose(channel);
+        shellLogs[channel] = false;
+        printLine("Closed.");
+        return;
     }
-    else if (baseCmd == "nslookup" || baseCmd == "dns") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: nslookup <host>");
+
+    int channel = logFind(argv[1]);
+    if (channel < 0 || !shellLogs[channel]) {
+        channel = logOpen(argv[1]);
+        if (channel < 0) {
+            printLine("log: no free channel (max " + String(LOG_CHANNELS) + "), close one with log -c");
             return;
         }
-        dnsLookup(args.arg1);
-    }
-    else if (baseCmd == "mem" || baseCmd == "memory") {
-        showMem();
+        shellLogs[channel] = true;
     }
-    else if (baseCmd == "uptime") {
-        showUptime();
-    }
-    else if (baseCmd == "reboot" || baseCmd == "restart") {
-        doReboot();
-    }
-    else if (baseCmd == "fetch" || baseCmd == "neofetch" || baseCmd == "fastfetch" ) {
-        fetch();
-    }
-    else if (baseCmd == "os" || baseCmd == "logo") {
-        showLogo();
-    }
-    else if (baseCmd == "version" || baseCmd == "ver") {
-        showVersion();
-    }
-    else if (baseCmd == "clear" || baseCmd == "cls") {
-        clearScreen();
-        tft.print("> ");
-    }
-    else if (baseCmd == "history" || baseCmd == "hist") {
-        showHistory();
-    }
-    else if (baseCmd == "ps" || baseCmd == "processes" || baseCmd == "top") {
-        listProcesses();
+    if (!logLine(channel, argv[2])) printLine("log: write failed");
+}
+static void cmdMv(int argc, char** argv)       { renameFile(argv[1], argv[2]); }
+static void cmdCp(int argc, char** argv) {
+    bool verify = argc == 4 && strcmp(argv[1], "-v") == 0;
+    if (argc == 4 && !verify) {
+        printLine("Usage: cp [-v] <src> <dst>");
+        return;
     }
-    else if (baseCmd == "sysstat" || baseCmd == "stat") {
-        showSystemStats();
+    copyFile(argv[argc - 2], argv[argc - 1], verify);
+}
+
+static void cmdMem(int argc, char** argv)      { showMem(); }
+static void cmdUptime(int argc, char** argv)   { showUptime(); }
+static void cmdReboot(int argc, char** argv)   { doReboot(); }
+static void cmdFetch(int argc, char** argv)    { fetch(); }
+static void cmdLogo(int argc, char** argv)     { showLogo(); }
+static void cmdVersion(int argc, char** argv)  { showVersion(); }
+static void cmdHistory(int argc, char** argv)  { showHistory(); }
+static void cmdTty(int argc, char** argv)      { ttyShowStats(); }
+static void cmdConsole(int argc, char** argv)  { consoleShowStats(); }
+
+static void cmdClear(int argc, char** argv) { clearScreen(); }
+
+static void cmdHelp(int argc, char** argv) {
+    if (argc < 2) showHelp();
+    else showHelpTopic(argv[1]);
+}
+
+static void cmdWifi(int argc, char** argv) {
+    if (argc == 1) {
+        connectWiFi();
+    } else if (strcmp(argv[1], "disconnect") == 0) {
+        disconnectWiFi();
+    } else if (strcmp(argv[1], "list") == 0) {
+        listWiFiProfiles();
+    } else if (strcmp(argv[1], "forget") == 0 && argc == 3) {
+        forgetWiFiProfile(argv[2]);
+    } else if (argc == 2) {
+        connectSavedWiFi(argv[1]);
+    } else {
+        printLine("Usage: wifi [<ssid>|list|forget <ssid>|disconnect]");
     }
-    else if (baseCmd == "kill") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: kill <pid>");
+}
+
+static void cmdDisconnect(int argc, char** argv) { disconnectWiFi(); }
+static void cmdScanWifi(int argc, char** argv) {
+    ScanFilter filter;
+    bool wait = false;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcasecmp(argv[i], "chan") == 0 && argc == 2) {
+            scanChannels();
             return;
-        }
-        int pid = args.arg1.toInt();
-        if (pid <= 0) {
-            printLine("Invalid PID");
+        } else if (strcmp(argv[i], "-w") == 0) {
+            wait = true;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            i++;
+            if (strcasecmp(argv[i], "ch") == 0) filter.sort = SCAN_SORT_CHANNEL;
+            else if (strcasecmp(argv[i], "ssid") == 0) filter.sort = SCAN_SORT_SSID;
+            else filter.sort = SCAN_SORT_RSSI;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            filter.channel = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            filter.minRssi = atoi(argv[++i]);
+        } else {
+            printLine("Usage: scanwifi [-w] [-s rssi|ch|ssid] [-c ch] [-r dBm] | chan");
             return;
         }
-        killProcess(pid);
     }
-    else if (baseCmd == "echo") {
-        echoCommand(args.arg1 + (args.rest.length() > 0 ? " " + args.rest : ""));
+    scanWiFi(filter, wait);
+}
+static void cmdIfconfig(int argc, char** argv)   { showNetworkInfo(); }
+static void cmdPing(int argc, char** argv)       { pingHost(argv[1]); }
+static void cmdNslookup(int argc, char** argv)   { dnsLookup(argv[1]); }
+
+static void cmdPingmon(int argc, char** argv) {
+    if (argc == 1) {
+        pingmonShow();
+        return;
     }
-    else if (baseCmd == "calc") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: calc <expression>");
-            return;
-        }
-        calc(args.arg1 + (args.rest.length() > 0 ? " " + args.rest : ""));
+    if (strcasecmp(argv[1], "stop") == 0) {
+        pingmonStop();
+        return;
     }
-    else if (baseCmd == "hex") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: hex <number>");
-            return;
-        }
-        hexCommand(args.arg1);
+    if (strcasecmp(argv[1], "view") == 0) {
+        pingmonView();
+        return;
     }
-    else if (baseCmd == "bin") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: bin <number>");
+    
+    int first = 1;
+    int interval = PINGMON_INTERVAL_MS;
+    if (strcmp(argv[1], "-i") == 0) {
+        if (argc < 4) {
+            printLine("Usage: pingmon [-i ms] <host> [host...]");
             return;
         }
-        binCommand(args.arg1);
+        interval = atoi(argv[2]);
+        first = 3;
     }
-    else if (baseCmd == "base64") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: base64 encode <text>");
-            printLine("       base64 decode <text>");
-            return;
-        }
-        
-        String operation = args.arg1;
-        String text = args.arg2;
-        if (args.rest.length() > 0) {
-            text = args.arg2 + " " + args.rest;
-        }
-        
-        if (text.length() == 0) {
-            printLine("Usage: base64 encode <text>");
-            printLine("       base64 decode <text>");
-            return;
-        }
-        
-        base64Command(operation, text);
-    }   
-    else if (baseCmd == "time" || baseCmd == "date") {
-        printLine(getTime());
+    pingmonStart(interval, argv + first, argc - first);
+}
+
+static void cmdCurl(int argc, char** argv) {
+    CurlOptions opts;
+    bool background = false;
+    
+    size_t lastLen = strlen(argv[argc - 1]);
+    if (lastLen > 0 && argv[argc - 1][lastLen - 1] == '&') {
+        background = true;
+        argv[argc - 1][lastLen - 1] = '\0';
+        if (lastLen == 1) argc--;
     }
-    else if (baseCmd == "synctime" || baseCmd == "ntpupdate") {
-        syncTime();
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            opts.verbose = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            opts.outFile = argv[++i];
+        } else if (opts.url.length() == 0 && argv[i][0] != '-') {
+            opts.url = argv[i];
+        } else {
+            opts.url = "";
+            break;
+        }
     }
-    else if (baseCmd == "calendar" || baseCmd == "cal") {
-        showCalendar();
+    
+    if (opts.url.length() == 0) {
+        printLine("Usage: curl [-v] [-o file] <url> [&]");
+        return;
     }
-    else if (baseCmd == "timer") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: timer <seconds>");
+    
+    if (background) {
+        if (!isConnected()) {
+            printLine("curl: not connected to WiFi");
             return;
         }
-        int seconds = args.arg1.toInt();
-        if (seconds <= 0) {
-            printLine("Invalid time");
+        if (!opts.url.startsWith("http://") && !opts.url.startsWith("https://")) {
+            printLine("curl: invalid URL (must start with http:// or https://)");
             return;
         }
-        timerCommand(seconds);
-    }
-    else if (baseCmd == "stopwatch" || baseCmd == "sw") {
-        stopwatchCommand();
-    }
-    else if (baseCmd == "alarm") {
-        if (args.arg1.length() == 0) {
-            if (systemAlarm.active) {
-                printLine("Alarm set for " + String(systemAlarm.hour) + ":" + 
-                         (systemAlarm.minute < 10 ? "0" : "") + String(systemAlarm.minute));
-            } else {
-                printLine("No alarm set.");
-            }
-        } else {
-            setAlarm(args.arg1);
-        }
-    }
-    else if (baseCmd == "themes") {
-        listThemes();
+        int id = curlSubmit(opts);
+        if (id > 0) printLine("[" + String(id) + "] " + opts.url);
+        return;
     }
-    else if (baseCmd == "theme") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: theme <number>");
-            listThemes();
+    curlWithOptions(opts);
+}
+
+static void cmdWget(int argc, char** argv) { wgetCommand(argv[1], argv[2]); }
+static void cmdJobs(int argc, char** argv)     { listJobs(); }
+static void cmdFg(int argc, char** argv)       { foregroundJob(atoi(argv[1])); }
+static void cmdHttpPool(int argc, char** argv) { httpPoolShow(); }
+
+static void cmdHttpBench(int argc, char** argv) {
+    httpBench(argv[1], argc > 2 ? atoi(argv[2]) : HTTP_BENCH_DEFAULT);
+}
+
+static void cmdCalc(int argc, char** argv)   { calc(argv[1]); }
+static void cmdHex(int argc, char** argv)    { hexCommand(argv[1]); }
+static void cmdBin(int argc, char** argv)    { binCommand(argv[1]); }
+static void cmdBase64(int argc, char** argv) { base64Command(argv[1], argv[2]); }
+static void cmdEcho(int argc, char** argv)   { echoCommand(argc > 1 ? argv[1] : ""); }
+
+static void cmdGraph(int argc, char** argv) {
+    if (strcmp(argv[1], "-b") == 0) {
+        if (argc < 3) {
+            printLine("Usage: graph -b <expression>");
             return;
         }
-        setTheme(args.arg1);
+        benchGraph(argv[2]);
+        return;
     }
-    else if (baseCmd == "pug") {
-        displayPug();
+    funcToGraph(argv[1], argc > 2 ? argv[2] : "blue");
+}
+
+static void cmdTime(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "-v") == 0) showTimeVerbose();
+    else printLine(getTime());
+}
+static void cmdSyncTime(int argc, char** argv)  { syncTime(); }
+static void cmdCalendar(int argc, char** argv)  { showCalendar(); }
+static void cmdStopwatch(int argc, char** argv) { stopwatchCommand(); }
+static void cmdLap(int argc, char** argv)       { stopwatchLap(); }
+static void cmdStop(int argc, char** argv)      { stopwatchStop(); }
+
+static void cmdTimer(int argc, char** argv) {
+    int seconds = atoi(argv[1]);
+    if (seconds <= 0) {
+        printLine("Invalid time");
+        return;
     }
-    else if (baseCmd == "screensaver" || baseCmd == "ss") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: screensaver <mode>");
-            printLine("Available modes: 1-7");
-            return;
-        }
-        
-        int mode = args.arg1.toInt();
-        if (mode < 1 || mode > 7) {
-            printLine("Invalid mode. Use 1-7.");
-            return;
-        }
-        
-        screensaver(mode);
+    timerCommand(seconds);
+}
+
+static void cmdAlarm(int argc, char** argv) {
+    if (argc > 1) setAlarm(argv[1]);
+    else listEntries(SCHED_MASK(SCHED_ALARM));
+}
+
+static void cmdCron(int argc, char** argv) {
+    if (argc == 1) {
+        listEntries(SCHED_MASK(SCHED_CRON_EVERY) | SCHED_MASK(SCHED_CRON_DAILY));
+        return;
     }
-    else if (baseCmd == "graph" || baseCmd == "plot") {
-        if (args.arg1.length() == 0) {
-            printLine("Usage: graph <expression> [color]");
-            printLine("Example: graph sin(x) red");
-            return;
-        }
-        String color = args.arg2.length() > 0 ? args.arg2 : "blue";
-        funcToGraph(args.arg1, color);
-    }
-    else if (baseCmd == "help" || baseCmd == "h") {
-        if (args.arg1.length() == 0) {
-            showHelp();
-        } else if (args.arg1 == "file") {
-            showHelpFile();
-        } else if (args.arg1 == "system") {
-            showHelpSystem();
-        } else if (args.arg1 == "network") {
-            showHelpNetwork();
-        } else if (args.arg1 == "utils") {
-            showHelpUtils();
-        } else if (args.arg1 == "time") {
-            showHelpTime();
-        } else if (args.arg1 == "display") {
-            showHelpDisplay();
-        } else if (args.arg1 == "os") {
-            showHelpOS();
-        } else {
-            printLine("Unknown help topic: " + args.arg1);
-            showHelp();
-        }
+    if (argc < 3) {
+        printLine("Usage: cron <HH:MM|30s|5m|2h> <command>");
+        return;
     }
-    else {
-        printLine("Unknown command: " + baseCmd);
-        printLine("Type 'help' for available commands");
+    int id = addCron(argv[1], argv[2]);
+    if (id > 0) printLine("Cron #" + String(id) + ": " + String(argv[2]));
+}
+
+static void cmdSched(int argc, char** argv) { listEntries(SCHED_MASK_ALL); }
+
+static void cmdCancel(int argc, char** argv) {
+    int id = atoi(argv[1]);
+    if (cancelEntry(id)) printLine("Cancelled #" + String(id));
+    else printLine("cancel: no entry #" + String(argv[1]));
+}
+
+static void cmdThemes(int argc, char** argv) { listThemes(); }
+static void cmdPug(int argc, char** argv)    { displayPug(); }
+
+static void cmdTheme(int argc, char** argv) {
+    if (argc < 2) {
+        printLine("Usage: theme <number>");
+        listThemes();
+        return;
+    }
+    setTheme(argv[1]);
+}
+
+static void cmdScreensaver(int argc, char** argv) {
+    int mode = atoi(argv[1]);
+    if (mode < 1 || mode > 7) {
+        printLine("Invalid mode. Use 1-7.");
+        return;
+    }
+    screensaver(mode);
+}
+
+static void cmdPs(int argc, char** argv)      { listProcesses(); }
+static void cmdTop(int argc, char** argv)     { topCommand(); }
+static void cmdSysstat(int argc, char** argv) { showSystemStats(); }
+
+static void cmdKill(int argc, char** argv) {
+    int pid = atoi(argv[1]);
+    if (pid <= 0) {
+        printLine("Invalid PID");
+        return;
     }
+    killProcess(pid);
+}
+
+static const Command coreCommands[] = {
+    // name         aliases                      group      min max flags     usage                      help
+    {"write",       "",                          "file",    2, 2, CMD_REST, "write <file> <text>",     "Write text",            cmdWrite},
+    {"append",      "",                          "file",    2, 2, CMD_REST, "append <file> <text>",    "Append text",           cmdAppend},
+    {"read",        "cat",                       "file",    1, 3, 0,        "read <file> [off len]",   "Read file",             cmdRead},
+    {"head",        "",                          "file",    1, 3, 0,        "head [-n N] <file>",      "First lines of file",   cmdHead},
+    {"tail",        "",                          "file",    1, 3, 0,        "tail [-n N] <file>",      "Last lines of file",    cmdTail},
+    {"more",        "less",                      "file",    1, 1, 0,        "more <file>",             "Page through file",     cmdMore},
+    {"mkdir",       "md",                        "file",    1, 1, 0,        "mkdir <dir>",             "Create directory",      cmdMkdir},
+    {"rmdir",       "rd",                        "file",    1, 1, 0,        "rmdir <dir>",             "Remove empty directory", cmdRmdir},
+    {"cd",          "",                          "file",    0, 1, 0,        "cd [dir]",                "Change directory",      cmdCd},
+    {"pwd",         "",                          "file",    0, 0, 0,        "pwd",                     "Current directory",     cmdPwd},
+    {"fsmigrate",   "",                          "file",    0, 0, 0,        "fsmigrate",               "Convert SPIFFS to LittleFS", cmdFsMigrate},
+    {"fsbench",     "",                          "file",    0, 0, 0,        "fsbench",                 "Filesystem latency",    cmdFsBench},
+    {"readbench",   "",                          "file",    1, 1, 0,        "readbench <file>",        "File read speed",       cmdReadBench},
+    {"delete",      "rm",                        "file",    1, 1, 0,        "delete <file>",           "Delete file",           cmdDelete},
+    {"ls",          "dir",                       "file",    0, 3, 0,        "ls [-S|-t] [-r] [pattern]", "List files",          cmdLs},
+    {"find",        "",                          "file",    1, 1, 0,        "find <pattern>",          "Find files by name",    cmdFind},
+    {"log",         "",                          "file",    0, 2, CMD_REST, "log [-c] [<file> <text>]", "Buffered append",       cmdLog},
+    {"sync",        "",                          "file",    0, 0, 0,        "sync",                    "Flush log buffers",     cmdSync},
+    {"mv",          "rename",                    "file",    2, 2, 0,        "mv <old> <new>",          "Rename file",           cmdMv},
+    {"cp",          "copy",                      "file",    2, 3, 0,        "cp [-v] <src> <dst>",     "Copy file",             cmdCp},
+
+    {"mem",         "memory free",               "system",  0, 0, 0,        "mem",                     "Memory info",           cmdMem},
+    {"uptime",      "",                          "system",  0, 0, 0,        "uptime",                  "System uptime",         cmdUptime},
+    {"reboot",      "restart",                   "system",  0, 0, 0,        "reboot",                  "Restart device",        cmdReboot},
+    {"fetch",       "neofetch fastfetch",        "system",  0, 0, 0,        "fetch",                   "System info",           cmdFetch},
+    {"os",          "logo",                      "system",  0, 0, 0,        "os",                      "OS logo",               cmdLogo},
+    {"version",     "ver",                       "system",  0, 0, 0,        "version",                 "OS version",            cmdVersion},
+    {"clear",       "cls",                       "system",  0, 0, 0,        "clear",                   "Clear display",         cmdClear},
+    {"history",     "hist",                      "system",  0, 0, 0,        "history",                 "Command history",       cmdHistory},
+    {"tty",         "",                          "system",  0, 0, 0,        "tty",                     "Serial line statistics", cmdTty},
+    {"console",     "",                          "system",  0, 0, 0,        "console",                 "Console draw statistics", cmdConsole},
+    {"help",        "h",                         "system",  0, 1, 0,        "help [topic]",            "Command help",          cmdHelp},
+
+    {"wifi",        "",                          "network", 0, 2, 0,        "wifi [ssid|list|forget]", "Connect to WiFi",       cmdWifi},
+    {"disconnect",  "",                          "network", 0, 0, 0,        "disconnect",              "Disconnect WiFi",       cmdDisconnect},
+    {"scanwifi",    "wifiscan",                  "network", 0, 8, 0,        "scanwifi [opts|chan]",    "Scan networks",         cmdScanWifi},
+    {"ifconfig",    "netinfo ipconfig",          "network", 0, 0, 0,        "ifconfig",                "Network info",          cmdIfconfig},
+    {"ping",        "",                          "network", 1, 1, 0,        "ping <host>",             "Ping host",             cmdPing},
+    {"nslookup",    "dns",                       "network", 1, 1, 0,        "nslookup <host|-c>",      "DNS lookup",            cmdNslookup},
+    {"pingmon",     "",                          "network", 0, 8, 0,        "pingmon [-i ms] <host..>", "Latency monitor",      cmdPingmon},
+    {"curl",        "",                          "network", 1, 5, 0,        "curl [-v] [-o file] <url> [&]", "Fetch URL",       cmdCurl},
+    {"jobs",        "",                          "network", 0, 0, 0,        "jobs",                    "Background curl jobs",  cmdJobs},
+    {"fg",          "",                          "network", 1, 1, 0,        "fg <id>",                 "Show curl job result",  cmdFg},
+    {"wget",        "",                          "network", 2, 2, 0,        "wget <url> <file>",       "Download to file",      cmdWget},
+    {"httppool",    "",                          "network", 0, 0, 0,        "httppool",                "HTTP connection pool",  cmdHttpPool},
+    {"httpbench",   "",                          "network", 1, 2, 0,        "httpbench <url> [count]", "Pooled vs new GETs",    cmdHttpBench},
+
+    {"calc",        "",                          "utils",   1, 1, CMD_REST, "calc <expr>",             "Calculator",            cmdCalc},
+    {"hex",         "",                          "utils",   1, 1, 0,        "hex <number>",            "Dec to hex",            cmdHex},
+    {"bin",         "",                          "utils",   1, 1, 0,        "bin <number>",            "Dec to bin",            cmdBin},
+    {"base64",      "",                          "utils",   2, 2, CMD_REST, "base64 <encode|decode> <text>", "Base64",          cmdBase64},
+    {"graph",       "plot",                      "utils",   1, 2, 0,        "graph [-b] <expr> [colour]", "Graph function",     cmdGraph},
+    {"echo",        "",                          "utils",   0, 1, CMD_REST, "echo <text>",             "Print text",            cmdEcho},
+
+    {"time",        "date",                      "time",    0, 1, 0,        "time [-v]",               "Current time",          cmdTime},
+    {"synctime",    "ntpupdate",                 "time",    0, 0, 0,        "synctime",                "Sync with NTP",         cmdSyncTime},
+    {"calendar",    "cal",                       "time",    0, 0, 0,        "calendar",                "Show calendar",         cmdCalendar},
+    {"timer",       "",                          "time",    1, 1, 0,        "timer <sec>",             "Countdown timer",       cmdTimer},
+    {"stopwatch",   "sw",                        "time",    0, 0, 0,        "stopwatch",               "Elapsed timer",         cmdStopwatch},
+    {"lap",         "",                          "time",    0, 0, 0,        "lap",                     "Stopwatch lap",         cmdLap},
+    {"stop",        "",                          "time",    0, 0, 0,        "stop",                    "Stop stopwatch",        cmdStop},
+    {"alarm",       "",                          "time",    0, 1, CMD_REST, "alarm [HH:MM [msg]]",     "Set or list alarms",    cmdAlarm},
+    {"cron",        "",                          "time",    0, 2, CMD_REST, "cron [<spec> <cmd>]",     "Repeat a command",      cmdCron},
+    {"sched",       "",                          "time",    0, 0, 0,        "sched",                   "List scheduled entries", cmdSched},
+    {"cancel",      "",                          "time",    1, 1, 0,        "cancel <id>",             "Cancel scheduled entry", cmdCancel},
+
+    {"themes",      "",                          "display", 0, 0, 0,        "themes",                  "List themes",           cmdThemes},
+    {"theme",       "",                          "display", 0, 1, 0,        "theme <n>",               "Select theme",          cmdTheme},
+    {"screensaver", "ss",                        "display", 1, 1, 0,        "screensaver <1-7>",       "Run screensaver",       cmdScreensaver},
+    {"pug",         "",                          "display", 0, 0, 0,        "pug",                     "Show pug image",        cmdPug},
+
+    {"ps",          "processes",                 "os",      0, 0, 0,        "ps",                      "List processes",        cmdPs},
+    {"top",         "",                          "os",      0, 0, 0,        "top",                     "Live CPU/process view", cmdTop},
+    {"sysstat",     "stat",                      "os",      0, 0, 0,        "sysstat",                 "System stats",          cmdSysstat},
+    {"kill",        "",                          "os",      1, 1, 0,        "kill <pid>",              "Kill process",          cmdKill},
+};
+
+void initCommands() {
+    registerCommands(coreCommands, sizeof(coreCommands) / sizeof(coreCommands[0]));
 }
 
 
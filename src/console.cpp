@@ -0,0 +1,264 @@
+#include "console.h"
+#include "display.h"
+#include "theme.h"
+#include <Adafruit_GFX.h>
+#include <freertos/semphr.h>
+
+// Text console behind printLine(). The screen is a ring of character rows;
+// scrolling moves the ring's top index instead of copying text. What is on
+// the panel is remembered per row, so a flush only pushes the span of cells
+// that actually changed, rendered through a one-row canvas in a single
+// address window. The panel is used in landscape, where the ST7789's
+// vertical scroll area runs along the wrong axis, so scrolling jumps
+// CONSOLE_JUMP rows at a time instead of redrawing every line.
+
+#define WINDOW_BYTES 11
+#define FOREIGN_CELL '\x01'
+
+static char text[CONSOLE_ROWS][CONSOLE_COLS];
+static char shown[CONSOLE_ROWS][CONSOLE_COLS];
+static char statusText[CONSOLE_COLS];
+static char statusShown[CONSOLE_COLS];
+static int top = 0;
+static int cursor = 0;
+static uint32_t dirtyRows = 0;
+
+static GFXcanvas16 rowCanvas(CONSOLE_WIDTH, CONSOLE_CHAR_H);
+static SemaphoreHandle_t consoleMutex = NULL;
+
+static uint32_t statLines = 0;
+static uint32_t statScrolls = 0;
+static uint32_t statSpans = 0;
+static uint32_t statBytes = 0;
+
+#define ALL_ROWS ((1UL << CONSOLE_ROWS) - 1)
+
+static void lock() {
+    if (consoleMutex) xSemaphoreTake(consoleMutex, portMAX_DELAY);
+}
+
+static void unlock() {
+    if (consoleMutex) xSemaphoreGive(consoleMutex);
+}
+
+static char* rowText(int row) {
+    return text[(top + row) % CONSOLE_ROWS];
+}
+
+static void scrollUp() {
+    for (int i = 0; i < CONSOLE_JUMP; i++) {
+        memset(text[(top + i) % CONSOLE_ROWS], ' ', CONSOLE_COLS);
+    }
+    top = (top + CONSOLE_JUMP) % CONSOLE_ROWS;
+    cursor -= CONSOLE_JUMP;
+    dirtyRows = ALL_ROWS;
+    statScrolls++;
+}
+
+static void drawSpan(int16_t y, const char* cells, int first, int last,
+                     uint16_t fg, uint16_t bg) {
+    int x = first * CONSOLE_CHAR_W;
+    int w = (last - first + 1) * CONSOLE_CHAR_W;
+
+    rowCanvas.fillRect(x, 0, w, CONSOLE_CHAR_H, bg);
+    for (int c = first; c <= last; c++) {
+        if (cells[c] != ' ') {
+            rowCanvas.drawChar(c * CONSOLE_CHAR_W, 0, cells[c], fg, bg, 1);
+        }
+    }
+
+    uint16_t* pixels = rowCanvas.getBuffer();
+    tft.startWrite();
+    tft.setAddrWindow(CONSOLE_X + x, y, w, CONSOLE_CHAR_H);
+    for (int y = 0; y < CONSOLE_CHAR_H; y++) {
+        tft.writePixels(pixels + y * CONSOLE_WIDTH + x, w);
+    }
+    tft.endWrite();
+
+    statSpans++;
+    statBytes += w * CONSOLE_CHAR_H * 2 + WINDOW_BYTES;
+}
+
+static void flush() {
+    if (screenLocked || dirtyRows == 0) return;
+
+    Theme current = getCurrentTheme();
+    for (int row = 0; row < CONSOLE_ROWS; row++) {
+        if (!(dirtyRows & (1UL << row))) continue;
+
+        const char* cells = rowText(row);
+        int first = 0;
+        int last = CONSOLE_COLS - 1;
+        while (first <= last && cells[first] == shown[row][first]) first++;
+        while (last >= first && cells[last] == shown[row][last]) last--;
+
+        if (first <= last) {
+            drawSpan(row * CONSOLE_CHAR_H, cells, first, last, current.fg, current.bg);
+            memcpy(&shown[row][first], &cells[first], last - first + 1);
+        }
+    }
+    dirtyRows = 0;
+}
+
+// The status bar is the pixel band below the text rows.
+static void flushStatus() {
+    if (screenLocked) return;
+
+    int first = 0;
+    int last = CONSOLE_COLS - 1;
+    while (first <= last && statusText[first] == statusShown[first]) first++;
+    while (last >= first && statusText[last] == statusShown[last]) last--;
+    if (first > last) return;
+
+    Theme current = getCurrentTheme();
+    drawSpan(STATUS_Y, statusText, first, last, current.fg, current.bg);
+    memcpy(&statusShown[first], &statusText[first], last - first + 1);
+}
+
+static void newRow() {
+    if (cursor >= CONSOLE_ROWS) scrollUp();
+    memset(rowText(cursor), ' ', CONSOLE_COLS);
+    dirtyRows |= 1UL << cursor;
+    cursor++;
+}
+
+void consoleInit() {
+    if (consoleMutex == NULL) consoleMutex = xSemaphoreCreateMutex();
+    memset(text, ' ', sizeof(text));
+    memset(shown, ' ', sizeof(shown));
+    memset(statusText, ' ', sizeof(statusText));
+    memset(statusShown, ' ', sizeof(statusShown));
+    top = 0;
+    cursor = 0;
+    dirtyRows = 0;
+}
+
+// Appends one logical line, wrapping at CONSOLE_COLS and at embedded '\n'.
+void consoleWrite(const char* s) {
+    lock();
+
+    newRow();
+    int col = 0;
+    for (const char* p = s; *p; p++) {
+        if (*p == '\n') {
+            newRow();
+            col = 0;
+            continue;
+        }
+        if (*p == '\r') continue;
+        if (col == CONSOLE_COLS) {
+            newRow();
+            col = 0;
+        }
+        rowText(cursor - 1)[col++] = (*p == '\t') ? ' ' : *p;
+    }
+    statLines++;
+    flush();
+
+    unlock();
+}
+
+// Replaces the text of the most recent row in place; only the changed
+// cells are pushed, which suits counters that update every second.
+void consoleRewriteLast(const char* s) {
+    lock();
+
+    if (cursor == 0) newRow();
+    char* cells = rowText(cursor - 1);
+    memset(cells, ' ', CONSOLE_COLS);
+    for (int col = 0; col < CONSOLE_COLS && s[col] && s[col] != '\n'; col++) {
+        cells[col] = s[col];
+    }
+    dirtyRows |= 1UL << (cursor - 1);
+    flush();
+
+    unlock();
+}
+
+void consoleClear() {
+    lock();
+
+    memset(text, ' ', sizeof(text));
+    top = 0;
+    cursor = 0;
+    dirtyRows = ALL_ROWS;
+    flush();
+
+    unlock();
+}
+
+// Repaints everything after the panel was used for something else
+// (screensaver, graph, top) or the theme changed.
+void consoleRedraw() {
+    lock();
+
+    tft.fillScreen(getCurrentTheme().bg);
+    statBytes += 320 * 240 * 2 + WINDOW_BYTES;
+    memset(shown, ' ', sizeof(shown));
+    memset(statusShown, FOREIGN_CELL, sizeof(statusShown));
+    dirtyRows = ALL_ROWS;
+    flush();
+    flushStatus();
+
+    unlock();
+}
+
+// Hands the next rows to the caller for direct drawing and returns their
+// top pixel row. They are marked foreign so the cells get repainted once
+// text reaches them again.
+int16_t consoleReserve(int rows) {
+    lock();
+
+    if (rows > CONSOLE_ROWS) rows = CONSOLE_ROWS;
+    for (int i = 0; i < rows; i++) newRow();
+    flush();
+
+    int first = cursor - rows;
+    for (int row = first; row < cursor; row++) {
+        memset(shown[row], FOREIGN_CELL, CONSOLE_COLS);
+    }
+
+    unlock();
+    return first * CONSOLE_CHAR_H;
+}
+
+// Sets one field of the status bar; "" clears it. Fields are
+// STATUS_FIELD_COLS wide and only changed cells reach the panel, so a
+// once-a-second counter costs a few characters of SPI traffic. While the
+// screen is locked the text is kept and drawn by the next consoleRedraw().
+void consoleStatus(int field, const char* s) {
+    if (field < 0 || field >= STATUS_FIELDS) return;
+    lock();
+
+    char* cells = statusText + field * STATUS_FIELD_COLS;
+    memset(cells, ' ', STATUS_FIELD_COLS);
+    for (int col = 0; col < STATUS_FIELD_COLS - 1 && s[col]; col++) {
+        cells[col + 1] = s[col];
+    }
+    flushStatus();
+
+    unlock();
+}
+
+void consoleShowStats() {
+    char line[80];
+
+    lock();
+    uint32_t lines = statLines;
+    uint32_t scrolls = statScrolls;
+    uint32_t spans = statSpans;
+    uint32_t bytes = statBytes;
+    unlock();
+
+    sprintf(line, "Lines: %lu  Scrolls: %lu  Spans: %lu",
+            (unsigned long)lines, (unsigned long)scrolls, (unsigned long)spans);
+    printLine(line);
+
+    sprintf(line, "SPI bytes: %lu", (unsigned long)bytes);
+    printLine(line);
+
+    if (lines > 0) {
+        sprintf(line, "Per 1000 lines: %.1f KB", bytes * 1000.0f / 1024.0f / lines);
+        printLine(line);
+    }
+}
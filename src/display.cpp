@@ -1,58 +1,47 @@
 #include "display.h"
 #include "theme.h"
 #include "config.h"
+#include "tty.h"
+#include "console.h"
+#include "fixmath.h"
 #include <Adafruit_GFX.h>
 
 Adafruit_ST7789 tft = Adafruit_ST7789(TFT_CS, TFT_DC, TFT_RST);
-int16_t currentCursorY = 0;
 
 
-uint8_t sin8(int angle) {
-    return (uint8_t)((sin(angle * M_PI / 128.0) + 1.0) * 127.5);
-}
-
 void initDisplay() {
     tft.init(240, 320);
+    tft.setSPISpeed(TFT_SPI_HZ);
     tft.setRotation(1);
     tft.setTextWrap(true);
     tft.invertDisplay(false);
+    if (!tft.initBandPipeline(320 * BAND_ROWS, 2)) {
+        Serial.println("[DISPLAY] Band pipeline unavailable");
+    }
+    fixInit();
+    consoleInit();
     applyTheme();
-    currentCursorY = 0;
 }
 
 void applyTheme() {
     Theme current = getCurrentTheme();
-    tft.fillScreen(current.bg);
-    tft.setTextColor(current.fg);
-    tft.setCursor(5, 0);
-    currentCursorY = 0;
+    tft.setTextColor(current.fg, current.bg);
+    consoleRedraw();
 }
 
 void clearScreen() {
-    Theme current = getCurrentTheme();
-    tft.fillScreen(current.bg);
-    tft.setCursor(5, 0);
-    currentCursorY = 0;
-    tft.setTextColor(current.fg, current.bg);
-    
+    consoleClear();
 }
 
-void printLine(String s) {
-    Theme current = getCurrentTheme();
-    
-    if (currentCursorY > MAX_Y) {
-        clearScreen();
-    }
-    
-    tft.setCursor(5, currentCursorY);
-    tft.setTextColor(current.fg, current.bg);
-    tft.println(s);
-    
-    currentCursorY = tft.getCursorY();
-    
+void printLine(const char* s) {
+    consoleWrite(s);
     Serial.println(s);
 }
 
+void printLine(String s) {
+    printLine(s.c_str());
+}
+
 
 // void screensaver(int mode) {
 //     screenLocked = true;
@@ -187,153 +176,329 @@ void printLine(String s) {
 //     screenLocked = false;
 //     clearScreen();
 // }
+// Frames are rendered in bands of BAND_ROWS lines. While one band is being
+// clocked out by the display's transfer task, the next is computed into the
+// other buffer, so rendering and SPI overlap instead of taking turns.
+//
+// Each mode splits its formula into terms that depend only on the column,
+// the row, the frame, or the pixel's polar position, and fills tables for
+// them once per run or per frame. The per-pixel work is then integer adds
+// and table reads.
+
+#define SAVER_W 320
+#define SAVER_H 230
+#define SAVER_CX (SAVER_W / 2)
+#define SAVER_CY (SAVER_H / 2)
+#define SAVER_FPS 40
+#define POLAR_W (SAVER_CX + 1)
+#define POLAR_H (SAVER_CY + 1)
+
+static int16_t colTerm[SAVER_W];
+static int16_t rowTerm[SAVER_H];
+static int16_t radialTerm[256];
+static int16_t angleTerm[FIX_TURN + 1];
+static uint16_t palette[FIX_TURN];
+static uint8_t tanhIndex[1025];
+static uint8_t* polarDist = NULL;
+static uint8_t* polarAngle = NULL;
+static uint32_t noise = 0x12345678;
+
+static uint16_t rgb565(int r, int g, int b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+// Distance and quarter-turn angle for one quadrant; the other three are
+// mirrored in polarAt().
+static bool buildPolar() {
+    polarDist = (uint8_t*)malloc(POLAR_W * POLAR_H);
+    polarAngle = (uint8_t*)malloc(POLAR_W * POLAR_H);
+    if (!polarDist || !polarAngle) return false;
+
+    for (int dy = 0; dy < POLAR_H; dy++) {
+        for (int dx = 0; dx < POLAR_W; dx++) {
+            uint32_t d2 = dx * dx + dy * dy;
+            int dist = (fixSqrt(4 * d2) + 1) / 2;
+            int angle = fixAtan2(dy, dx);
+            polarDist[dy * POLAR_W + dx] = dist > 255 ? 255 : dist;
+            polarAngle[dy * POLAR_W + dx] = angle > 255 ? 255 : angle;
+        }
+    }
+    return true;
+}
+
+static void freePolar() {
+    free(polarDist);
+    free(polarAngle);
+    polarDist = NULL;
+    polarAngle = NULL;
+}
+
+static inline void polarAt(int dx, int dy, int& dist, int& angle) {
+    int ax = dx < 0 ? -dx : dx;
+    int ay = dy < 0 ? -dy : dy;
+    int i = ay * POLAR_W + ax;
+    int a = polarAngle[i];
+
+    if (dx < 0) a = FIX_HALF_TURN - a;
+    angle = dy < 0 ? -a : a;
+    dist = polarDist[i];
+}
+
+static bool saverSetup(int mode) {
+    switch (mode) {
+        case 1:
+            for (int i = 0; i <= 256; i++) {
+                int c = i > 255 ? 255 : i;
+                palette[256 + i] = rgb565(0, c, c);
+                palette[256 - i] = rgb565(0, 0, c);
+            }
+            break;
+
+        case 2:
+            for (int y = 0; y < SAVER_H; y++) {
+                rowTerm[y] = fixCos(y * 14668 / 1000) >> 6;
+            }
+            for (int d = -512; d <= 512; d++) {
+                int i = (int)((tanhf(d / 256.0f) + 1.0f) * 127.5f);
+                tanhIndex[d + 512] = constrain(i, 0, 255);
+            }
+            break;
+
+        case 3:
+            if (!buildPolar()) return false;
+            for (int d = 0; d < 256; d++) {
+                radialTerm[d] = d * 16298 / 1000;
+            }
+            for (int p = 0; p < FIX_TURN; p++) {
+                int i = (fixSin(p) + FIX_ONE) * 255 / (2 * FIX_ONE);
+                palette[p] = rgb565(i, i / 2, 255 - i);
+            }
+            break;
+
+        case 4:
+            for (int k = 1; k < 20; k++) {
+                palette[k] = rgb565(0, (20 - k) * 12, 0);
+            }
+            break;
+
+        case 5:
+            for (int y = 0; y < SAVER_H; y++) {
+                rowTerm[y] = (SAVER_H - y) * 256 / SAVER_H;
+            }
+            for (int heat = 0; heat < 256; heat++) {
+                if (heat < 85) {
+                    palette[heat] = rgb565(heat * 3, 0, 0);
+                } else if (heat < 170) {
+                    palette[heat] = rgb565(255, (heat - 85) * 3, 0);
+                } else {
+                    palette[heat] = rgb565(255, 255, (heat - 170) * 3);
+                }
+            }
+            break;
+
+        case 7:
+            if (!buildPolar()) return false;
+            for (int d = 0; d < 256; d++) {
+                int i = constrain(255 - d * 2, 0, 255);
+                radialTerm[d] = d > 1 ? 32 / d : 0;
+                palette[d] = rgb565(0, i, i);
+            }
+            // angle * 10 in radians, Q4
+            for (int a = -FIX_HALF_TURN; a <= FIX_HALF_TURN; a++) {
+                angleTerm[a + FIX_HALF_TURN] = a * 160000 / FIX_RAD_1000;
+            }
+            break;
+    }
+    return true;
+}
+
+static void saverFrame(int mode, int offset) {
+    switch (mode) {
+        case 1:
+            for (int x = 0; x < SAVER_W; x++) {
+                colTerm[x] = fixSin((x + offset) * 8149 / 1000) >> 6;
+            }
+            break;
+
+        case 2:
+            for (int x = 0; x < SAVER_W; x++) {
+                colTerm[x] = fixSin((x * 6519 - offset * 1630) / 1000) >> 6;
+            }
+            for (int i = 0; i < 256; i++) {
+                palette[i] = rgb565(sin8(i + offset), sin8(i + offset * 2), sin8(i + 128));
+            }
+            break;
+
+        case 4:
+            for (int x = 0; x < SAVER_W; x++) {
+                colTerm[x] = (offset + (x / 10) * 17) % SAVER_H;
+            }
+            break;
+
+        case 6:
+            for (int s = 0; s < 5; s++) {
+                int twinkle = (offset + s * 7) % 30;
+                int brightness = twinkle < 15 ? twinkle * 17 : (30 - twinkle) * 17;
+                palette[s] = rgb565(brightness, brightness, brightness);
+            }
+            break;
+    }
+}
+
+static void saverBand(int mode, int offset, uint16_t* out, int y0, int rows) {
+    for (int y = y0; y < y0 + rows; y++) {
+        int dy = y - SAVER_CY;
+
+        switch (mode) {
+            case 1: {
+                int ry = fixSin((2 * y + offset) * 8149 / 2000) >> 6;
+                for (int x = 0; x < SAVER_W; x++) {
+                    int p = (colTerm[x] * ry) >> 8;
+                    *out++ = palette[256 + p];
+                }
+                break;
+            }
+
+            case 2: {
+                int ry = rowTerm[y] - 512;
+                for (int x = 0; x < SAVER_W; x++) {
+                    *out++ = palette[tanhIndex[colTerm[x] - ry]];
+                }
+                break;
+            }
+
+            case 3: {
+                int phase0 = offset * 8149 / 1000;
+                for (int x = 0; x < SAVER_W; x++) {
+                    int dist, angle;
+                    polarAt(x - SAVER_CX, dy, dist, angle);
+                    *out++ = palette[(radialTerm[dist] - 2 * angle + phase0) & (FIX_TURN - 1)];
+                }
+                break;
+            }
+
+            case 4:
+                for (int x = 0; x < SAVER_W; x++) {
+                    int k = colTerm[x] - y;
+                    if (k == 0) *out++ = ST77XX_WHITE;
+                    else if (k > 0 && k < 20) *out++ = palette[k];
+                    else *out++ = ST77XX_BLACK;
+                }
+                break;
+
+            case 5: {
+                int base = rowTerm[y] - 20;
+                for (int x = 0; x < SAVER_W; x++) {
+                    noise ^= noise << 13;
+                    noise ^= noise >> 17;
+                    noise ^= noise << 5;
+                    int heat = base + (int)(((noise & 0xFFFF) * 40) >> 16);
+                    *out++ = palette[constrain(heat, 0, 255)];
+                }
+                break;
+            }
+
+            case 6: {
+                int seed = (y * 13) % 1000;
+                for (int x = 0; x < SAVER_W; x++) {
+                    *out++ = seed < 5 ? palette[seed] : ST77XX_BLACK;
+                    seed += 17;
+                    if (seed >= 1000) seed -= 1000;
+                }
+                break;
+            }
+
+            case 7:
+                for (int x = 0; x < SAVER_W; x++) {
+                    int dist, angle;
+                    polarAt(x - SAVER_CX, dy, dist, angle);
+                    uint16_t color = ST77XX_BLACK;
+                    if (dist > 1) {
+                        int u = radialTerm[dist] + offset;
+                        int v = (angleTerm[angle + FIX_HALF_TURN] + offset * 8) / 16;
+                        if ((u + v) % 20 < 10) color = palette[dist];
+                    }
+                    *out++ = color;
+                }
+                break;
+
+            default: {
+                int t = (y + offset) % 60;
+                for (int x = 0; x < SAVER_W; x++) {
+                    *out++ = t < 30 ? ST77XX_CYAN : ST77XX_BLUE;
+                    if (++t == 60) t = 0;
+                }
+                break;
+            }
+        }
+    }
+}
+
 void screensaver(int mode) {
+    if (!saverSetup(mode)) {
+        freePolar();
+        printLine("Not enough memory for this mode.");
+        return;
+    }
+    
     screenLocked = true;
-    const int width = 320;
-    const int height = 230;
     
     tft.fillScreen(ST77XX_BLACK);
     Serial.println("Press ENTER to exit...");
     
-    static uint16_t line[320];
-    
     int offset = 0;
-    const int targetFPS = 20;  
-    const int frameDelay = 1000 / targetFPS;
+    const int frameDelay = 1000 / SAVER_FPS;
+    
+    uint32_t frames = 0;
+    uint32_t renderUs = 0;
+    bool pipelined = tft.bandMaxPixels() > 0;
+    static uint16_t line[SAVER_W];
+    uint32_t directSpiUs = 0;
+    uint32_t spiStartUs = tft.bandBusyMicros();
+    uint32_t started = millis();
+    uint32_t windowFrames = 0;
+    uint32_t windowRenderUs = 0;
+    uint32_t windowSpiUs = spiStartUs;
+    uint32_t windowStart = started;
+    char status[54] = "Press ENTER to exit...";
+    bool statusChanged = true;
     
     while (true) {
         unsigned long frameStart = millis();
         
-        tft.startWrite();
-        
+        uint32_t renderStart = micros();
+        saverFrame(mode, offset);
+        renderUs += micros() - renderStart;
         
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                uint16_t color = ST77XX_BLACK;
+        if (pipelined) {
+            for (int y0 = 0; y0 < SAVER_H; y0 += BAND_ROWS) {
+                int rows = min(BAND_ROWS, SAVER_H - y0);
+                uint16_t* band = tft.getBandBuffer();
                 
-                switch(mode) {
-                    case 1: 
-                        {
-                            float wave = sin((x + offset) * 0.05) * sin((y + offset * 0.5) * 0.05);
-                            if (wave > 0) {
-                                int intensity = (int)(wave * 255);
-                                color = tft.color565(0, intensity, intensity);
-                            } else {
-                                int intensity = (int)(-wave * 255);
-                                color = tft.color565(0, 0, intensity);
-                            }
-                        }
-                        break;
-                        
-                    case 2: 
-                        {
-                            float v = tanh(sin(x * 0.04 - offset * 0.01) - cos(y * 0.09) );
-                            int i = (int)((v + 1.0) * 127.5);
-                            i = constrain(i, 0, 255);
-                            int shift = (offset+i / 10) % 256;
-                            uint8_t r = sin8(i + offset);      
-                            uint8_t g = sin8(i + offset * 2); 
-                            uint8_t b = (uint8_t)((sin((i + 128) * M_PI / 128.0) + 1.0) * 127.5);
-    
-                              color = tft.color565(r, g, b);
-                        }
-                        break;
-                        
-                    case 3: 
-                        {
-                            int dx = x - width / 2;
-                            int dy = y - height / 2;
-                            float angle = atan2(dy, dx);
-                            float dist = sqrt(dx * dx + dy * dy);
-                            
-                            float spiral = sin(dist * 0.1 - angle * 2 + offset * 0.05) * 0.5 + 0.5;
-                            int intensity = (int)(spiral * 255);
-                            
-                            color = tft.color565(intensity, intensity / 2, 255 - intensity);
-                        }
-                        break;
-                        
-                    case 4: 
-                        {
-                            int col = x / 10;
-                            int matrixOffset = (offset + col * 17) % height;
-                            
-                            if (y > matrixOffset - 20 && y < matrixOffset) {
-                                int brightness = (20 - (matrixOffset - y)) * 12;
-                                color = tft.color565(0, brightness, 0);
-                            } else if (y == matrixOffset) {
-                                color = ST77XX_WHITE;
-                            }
-                        }
-                        break;
-                        
-                    case 5: 
-                        {
-                            int heat = ((height - y) * 256 / height) + random(-20, 20);
-                            heat = constrain(heat, 0, 255);
-                            
-                            if (heat < 85) {
-                                color = tft.color565(heat * 3, 0, 0);
-                            } else if (heat < 170) {
-                                color = tft.color565(255, (heat - 85) * 3, 0);
-                            } else {
-                                color = tft.color565(255, 255, (heat - 170) * 3);
-                            }
-                        }
-                        break;
-                        
-                    case 6: 
-                        {
-                            int starSeed = (x * 17 + y * 13) % 1000;
-                            if (starSeed < 5) {
-                                int twinkle = (offset + starSeed * 7) % 30;
-                                int brightness = twinkle < 15 ? twinkle * 17 : (30 - twinkle) * 17;
-                                color = tft.color565(brightness, brightness, brightness);
-                            }
-                        }
-                        break;
-                        
-                    case 7: 
-                        {
-                            int dx = x - width / 2;
-                            int dy = y - height / 2;
-                            float dist = sqrt(dx * dx + dy * dy);
-                            float angle = atan2(dy, dx);
-                            
-                            if (dist > 1) {
-                                int u = (int)(32.0 / dist + offset);
-                                int v = (int)(angle * 10 + offset * 0.5);
-                                
-                                if ((u + v) % 20 < 10) {
-                                    int intensity = 255 - (int)(dist * 2);
-                                    intensity = constrain(intensity, 0, 255);
-                                    color = tft.color565(0, intensity, intensity);
-                                }
-                            }
-                        }
-                        break;
-                        
-                    default:
-                        color = ((x + y + offset) % 60 < 30) ? ST77XX_CYAN : ST77XX_BLUE;
-                        break;
-                }
+                renderStart = micros();
+                saverBand(mode, offset, band, y0, rows);
+                renderUs += micros() - renderStart;
                 
-                line[x] = color;
+                tft.pushBand(0, y0, SAVER_W, rows, band);
             }
             
-            
-            tft.setAddrWindow(0, y, width, 1);
-            tft.writePixels(line, width);
-            
-            
-            if (y % 10 == 0) {
-                tft.endWrite();
-                vTaskDelay(1 / portTICK_PERIOD_MS);  
-                tft.startWrite();
+            tft.waitIdle();
+        } else {
+            // No pipeline: render and send one line at a time
+            tft.startWrite();
+            tft.setAddrWindow(0, 0, SAVER_W, SAVER_H);
+            for (int y = 0; y < SAVER_H; y++) {
+                renderStart = micros();
+                saverBand(mode, offset, line, y, 1);
+                uint32_t sendStart = micros();
+                renderUs += sendStart - renderStart;
+                
+                tft.writePixels(line, SAVER_W);
+                directSpiUs += micros() - sendStart;
             }
+            tft.endWrite();
         }
-        
-        tft.endWrite();
+        frames++;
         
         
         if (mode == 2 || mode == 3) {
@@ -347,18 +512,33 @@ void screensaver(int mode) {
         if (offset > 10000) offset = 0;
         
         
-        tft.setTextColor(ST77XX_WHITE, ST77XX_BLACK);
-        tft.setTextSize(1);
-        tft.setCursor(5, 230);
-        tft.print("Press ENTER to exit...");
-        
+        uint32_t now = millis();
+        if (now - windowStart >= 1000) {
+            uint32_t n = frames - windowFrames;
+            uint32_t spiUs = tft.bandBusyMicros() + directSpiUs;
+            snprintf(status, sizeof(status), "ENTER to exit  %4.1f FPS  cpu %3lu ms  spi %3lu ms",
+                     n * 1000.0f / (now - windowStart),
+                     (unsigned long)((renderUs - windowRenderUs) / n / 1000),
+                     (unsigned long)((spiUs - windowSpiUs) / n / 1000));
+            windowFrames = frames;
+            windowRenderUs = renderUs;
+            windowSpiUs = spiUs;
+            windowStart = now;
+            statusChanged = true;
+        }
         
-        if (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n') break;
+        if (statusChanged) {
+            tft.setTextColor(ST77XX_WHITE, ST77XX_BLACK);
+            tft.setTextSize(1);
+            tft.setCursor(5, 230);
+            tft.print(status);
+            statusChanged = false;
         }
         
         
+        if (ttyEnterPressed()) break;
+        
+        
         unsigned long frameTime = millis() - frameStart;
         if (frameTime < frameDelay) {
             vTaskDelay((frameDelay - frameTime) / portTICK_PERIOD_MS);
@@ -367,10 +547,19 @@ void screensaver(int mode) {
         }
     }
     
-    applyTheme();
+    freePolar();
     screenLocked = false;
-    clearScreen();
-    tft.print("> ");
+    applyTheme();
+    
+    uint32_t elapsed = millis() - started;
+    if (frames > 0 && elapsed > 0) {
+        char line[80];
+        sprintf(line, "Screensaver: %.1f FPS, cpu %lu ms, spi %lu ms per frame",
+                frames * 1000.0f / elapsed,
+                (unsigned long)(renderUs / frames / 1000),
+                (unsigned long)((tft.bandBusyMicros() + directSpiUs - spiStartUs) / frames / 1000));
+        printLine(line);
+    }
 }
 
 void showLogo() {
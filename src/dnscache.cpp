@@ -0,0 +1,137 @@
+#include "dnscache.h"
+#include "display.h"
+#include <WiFi.h>
+#include <freertos/semphr.h>
+
+// Small LRU cache in front of WiFi.hostByName(). Failed lookups are kept
+// for a shorter time so a dead name does not cost a resolver timeout on
+// every retry. Lookups run with the cache unlocked so a slow resolver
+// never blocks other callers.
+
+struct DnsEntry {
+    char host[DNS_HOST_MAX];
+    IPAddress ip;
+    bool negative;
+    uint32_t stored;
+    uint32_t ttl;
+    uint32_t lastUsed;
+    uint32_t hits;
+};
+
+static DnsEntry cache[DNS_CACHE_SIZE];
+static SemaphoreHandle_t cacheMutex = NULL;
+static uint32_t hits = 0;
+static uint32_t misses = 0;
+
+static void lockCache() {
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+}
+
+static void unlockCache() {
+    xSemaphoreGive(cacheMutex);
+}
+
+void dnsCacheInit() {
+    cacheMutex = xSemaphoreCreateMutex();
+    memset(cache, 0, sizeof(cache));
+}
+
+static DnsEntry* lookup(const char* host, uint32_t now) {
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        DnsEntry& e = cache[i];
+        if (e.host[0] == '\0' || strcasecmp(e.host, host) != 0) continue;
+        if (now - e.stored >= e.ttl) {
+            e.host[0] = '\0';
+            return NULL;
+        }
+        return &e;
+    }
+    return NULL;
+}
+
+static void store(const char* host, const IPAddress& ip, bool negative, uint32_t now) {
+    DnsEntry* slot = NULL;
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        DnsEntry& e = cache[i];
+        if (e.host[0] == '\0' || strcasecmp(e.host, host) == 0) {
+            slot = &e;
+            break;
+        }
+        if (slot == NULL || e.lastUsed < slot->lastUsed) slot = &e;
+    }
+
+    strlcpy(slot->host, host, sizeof(slot->host));
+    slot->ip = ip;
+    slot->negative = negative;
+    slot->stored = now;
+    slot->ttl = negative ? DNS_NEGATIVE_TTL_MS : DNS_TTL_MS;
+    slot->lastUsed = now;
+    slot->hits = 0;
+}
+
+bool dnsResolve(const char* host, IPAddress& ip, DnsSource* source) {
+    if (ip.fromString(host)) {
+        if (source) *source = DNS_LITERAL;
+        return true;
+    }
+    if (strlen(host) >= DNS_HOST_MAX) {
+        if (source) *source = DNS_QUERIED;
+        return WiFi.hostByName(host, ip) == 1;
+    }
+
+    lockCache();
+    uint32_t now = millis();
+    DnsEntry* e = lookup(host, now);
+    if (e) {
+        e->lastUsed = now;
+        e->hits++;
+        hits++;
+        bool ok = !e->negative;
+        if (ok) ip = e->ip;
+        unlockCache();
+        if (source) *source = DNS_CACHED;
+        return ok;
+    }
+    misses++;
+    unlockCache();
+
+    IPAddress resolved;
+    bool ok = WiFi.hostByName(host, resolved) == 1;
+
+    lockCache();
+    store(host, resolved, !ok, millis());
+    unlockCache();
+
+    if (ok) ip = resolved;
+    if (source) *source = DNS_QUERIED;
+    return ok;
+}
+
+void dnsCacheShow() {
+    char line[80];
+    int shown = 0;
+
+    lockCache();
+    uint32_t now = millis();
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        DnsEntry& e = cache[i];
+        if (e.host[0] == '\0' || now - e.stored >= e.ttl) continue;
+        snprintf(line, sizeof(line), "  %-20.20s %-15s %4lus %3lu hit",
+                 e.host, e.negative ? "(not found)" : e.ip.toString().c_str(),
+                 (unsigned long)((e.ttl - (now - e.stored)) / 1000),
+                 (unsigned long)e.hits);
+        printLine(line);
+        shown++;
+    }
+    snprintf(line, sizeof(line), "%d cached, %lu hits, %lu misses", shown,
+             (unsigned long)hits, (unsigned long)misses);
+    unlockCache();
+
+    printLine(line);
+}
+
+void dnsCacheFlush() {
+    lockCache();
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) cache[i].host[0] = '\0';
+    unlockCache();
+}
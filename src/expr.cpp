@@ -0,0 +1,368 @@
+#include "expr.h"
+#include <math.h>
+
+#define EXPR_PI 3.14159265358979323846f
+#define EXPR_E  2.71828182845904523536f
+
+#define OPSTACK_SIZE 32
+
+struct ExprFunction {
+    const char* name;
+    ExprOp op;
+};
+
+static const ExprFunction exprFunctions[] = {
+    {"sqrt", EXPR_SQRT}, {"sin", EXPR_SIN}, {"cos", EXPR_COS}, {"tan", EXPR_TAN},
+    {"asin", EXPR_ASIN}, {"acos", EXPR_ACOS}, {"atan", EXPR_ATAN},
+    {"sinh", EXPR_SINH}, {"cosh", EXPR_COSH}, {"tanh", EXPR_TANH},
+    {"log", EXPR_LOG}, {"ln", EXPR_LN}, {"exp", EXPR_EXP},
+    {"abs", EXPR_ABS}, {"ceil", EXPR_CEIL}, {"floor", EXPR_FLOOR}, {"round", EXPR_ROUND}
+};
+
+static const int exprFunctionCount = sizeof(exprFunctions) / sizeof(ExprFunction);
+
+// Operator stack entries: binary/unary opcodes, functions, or an open paren.
+#define OPSTACK_PAREN 0xFF
+
+static int precedence(ExprOp op) {
+    switch (op) {
+        case EXPR_ADD: case EXPR_SUB: return 1;
+        case EXPR_MUL: case EXPR_DIV: case EXPR_MOD: return 2;
+        case EXPR_NEG: return 3;
+        case EXPR_POW: return 4;
+        default: return 0;
+    }
+}
+
+static bool isRightAssociative(ExprOp op) {
+    return op == EXPR_POW || op == EXPR_NEG;
+}
+
+static bool isBinary(ExprOp op) {
+    return op >= EXPR_ADD && op <= EXPR_POW;
+}
+
+static bool isFunctionOp(ExprOp op) {
+    return op >= EXPR_SQRT;
+}
+
+static float applyUnary(ExprOp op, float v) {
+    switch (op) {
+        case EXPR_NEG: return -v;
+        case EXPR_SQRT: return sqrtf(v);
+        case EXPR_SIN: return sinf(v);
+        case EXPR_COS: return cosf(v);
+        case EXPR_TAN: return tanf(v);
+        case EXPR_ASIN: return asinf(v);
+        case EXPR_ACOS: return acosf(v);
+        case EXPR_ATAN: return atanf(v);
+        case EXPR_SINH: return sinhf(v);
+        case EXPR_COSH: return coshf(v);
+        case EXPR_TANH: return tanhf(v);
+        case EXPR_LOG: return log10f(v);
+        case EXPR_LN: return logf(v);
+        case EXPR_EXP: return expf(v);
+        case EXPR_ABS: return fabsf(v);
+        case EXPR_CEIL: return ceilf(v);
+        case EXPR_FLOOR: return floorf(v);
+        case EXPR_ROUND: return roundf(v);
+        default: return v;
+    }
+}
+
+static ExprStatus applyBinary(ExprOp op, float a, float b, float& out) {
+    switch (op) {
+        case EXPR_ADD: out = a + b; break;
+        case EXPR_SUB: out = a - b; break;
+        case EXPR_MUL: out = a * b; break;
+        case EXPR_DIV:
+            if (b == 0) return EXPR_ERR_DIV_ZERO;
+            out = a / b;
+            break;
+        case EXPR_MOD:
+            if ((int)b == 0) return EXPR_ERR_MOD_ZERO;
+            out = (int)a % (int)b;
+            break;
+        case EXPR_POW: out = powf(a, b); break;
+        default: out = 0; break;
+    }
+    return EXPR_OK;
+}
+
+struct ExprCompiler {
+    ExprProgram* prog;
+    int depth;
+    bool overflow;
+};
+
+static void emit(ExprCompiler& c, ExprOp op, float value = 0) {
+    ExprProgram& p = *c.prog;
+
+    // Fold operations whose operands are already constant so the per-sample
+    // program only carries work that depends on x.
+    if (isBinary(op) && p.length >= 2 &&
+        p.code[p.length - 1].op == EXPR_PUSH_CONST &&
+        p.code[p.length - 2].op == EXPR_PUSH_CONST) {
+        float folded;
+        if (applyBinary(op, p.code[p.length - 2].value, p.code[p.length - 1].value, folded) == EXPR_OK) {
+            p.length--;
+            p.code[p.length - 1].value = folded;
+            c.depth--;
+            return;
+        }
+    } else if ((op == EXPR_NEG || isFunctionOp(op)) && p.length >= 1 &&
+               p.code[p.length - 1].op == EXPR_PUSH_CONST) {
+        p.code[p.length - 1].value = applyUnary(op, p.code[p.length - 1].value);
+        return;
+    }
+
+    if (p.length >= EXPR_MAX_CODE) {
+        c.overflow = true;
+        return;
+    }
+
+    p.code[p.length].op = op;
+    p.code[p.length].value = value;
+    p.length++;
+
+    if (op == EXPR_PUSH_CONST || op == EXPR_PUSH_X) {
+        if (++c.depth > EXPR_MAX_STACK) c.overflow = true;
+    } else if (isBinary(op)) {
+        c.depth--;
+    }
+}
+
+bool compileExpression(const char* expr, bool allowX, ExprProgram& program, String& error) {
+    ExprCompiler c = {&program, 0, false};
+    program.length = 0;
+    program.usesX = false;
+
+    uint8_t ops[OPSTACK_SIZE];
+    int oTop = -1;
+    bool expectOperand = true;
+    int i = 0;
+
+    while (expr[i] != '\0') {
+        char ch = expr[i];
+
+        if (ch == ' ') {
+            i++;
+            continue;
+        }
+
+        if (isdigit(ch) || ch == '.') {
+            if (!expectOperand) {
+                error = "Invalid expression";
+                return false;
+            }
+            float num = 0;
+            float scale = 0;
+            while (isdigit(expr[i]) || expr[i] == '.') {
+                if (expr[i] == '.') {
+                    if (scale != 0) {
+                        error = "Invalid number";
+                        return false;
+                    }
+                    scale = 1;
+                } else if (scale != 0) {
+                    scale *= 0.1f;
+                    num += (expr[i] - '0') * scale;
+                } else {
+                    num = num * 10 + (expr[i] - '0');
+                }
+                i++;
+            }
+            emit(c, EXPR_PUSH_CONST, num);
+            expectOperand = false;
+            continue;
+        }
+
+        if (isalpha(ch)) {
+            int start = i;
+            while (isalpha(expr[i])) i++;
+            int len = i - start;
+
+            if (!expectOperand) {
+                error = "Invalid expression";
+                return false;
+            }
+
+            if (len == 1 && (ch == 'x' || ch == 'X') && allowX) {
+                emit(c, EXPR_PUSH_X);
+                program.usesX = true;
+                expectOperand = false;
+                continue;
+            }
+            if (len == 2 && strncasecmp(expr + start, "pi", 2) == 0) {
+                emit(c, EXPR_PUSH_CONST, EXPR_PI);
+                expectOperand = false;
+                continue;
+            }
+            if (len == 1 && (ch == 'e' || ch == 'E')) {
+                emit(c, EXPR_PUSH_CONST, EXPR_E);
+                expectOperand = false;
+                continue;
+            }
+
+            int f = 0;
+            for (; f < exprFunctionCount; f++) {
+                if ((int)strlen(exprFunctions[f].name) == len &&
+                    strncasecmp(expr + start, exprFunctions[f].name, len) == 0) break;
+            }
+            if (f == exprFunctionCount) {
+                error = "Unknown name '" + String(expr + start).substring(0, len) + "'";
+                return false;
+            }
+
+            while (expr[i] == ' ') i++;
+            if (expr[i] != '(') {
+                error = String(exprFunctions[f].name) + " requires '('";
+                return false;
+            }
+            if (oTop + 2 >= OPSTACK_SIZE) {
+                error = "Expression too complex";
+                return false;
+            }
+            ops[++oTop] = exprFunctions[f].op;
+            ops[++oTop] = OPSTACK_PAREN;
+            i++;
+            continue;
+        }
+
+        if (ch == '(') {
+            if (!expectOperand) {
+                error = "Invalid expression";
+                return false;
+            }
+            if (oTop + 1 >= OPSTACK_SIZE) {
+                error = "Expression too complex";
+                return false;
+            }
+            ops[++oTop] = OPSTACK_PAREN;
+            i++;
+            continue;
+        }
+
+        if (ch == ')') {
+            if (expectOperand) {
+                error = "Invalid expression";
+                return false;
+            }
+            while (oTop >= 0 && ops[oTop] != OPSTACK_PAREN) {
+                emit(c, (ExprOp)ops[oTop--]);
+            }
+            if (oTop < 0) {
+                error = "Mismatched parentheses";
+                return false;
+            }
+            oTop--;
+            if (oTop >= 0 && ops[oTop] != OPSTACK_PAREN && isFunctionOp((ExprOp)ops[oTop])) {
+                emit(c, (ExprOp)ops[oTop--]);
+            }
+            i++;
+            continue;
+        }
+
+        ExprOp op;
+        switch (ch) {
+            case '+': op = EXPR_ADD; break;
+            case '-': op = EXPR_SUB; break;
+            case '*': op = EXPR_MUL; break;
+            case '/': op = EXPR_DIV; break;
+            case '%': op = EXPR_MOD; break;
+            case '^': op = EXPR_POW; break;
+            default:
+                error = "Invalid character '" + String(ch) + "'";
+                return false;
+        }
+        i++;
+
+        if (expectOperand) {
+            if (op == EXPR_ADD) continue;
+            if (op != EXPR_SUB) {
+                error = "Invalid expression";
+                return false;
+            }
+            op = EXPR_NEG;
+        } else {
+            while (oTop >= 0 && ops[oTop] != OPSTACK_PAREN &&
+                   (precedence((ExprOp)ops[oTop]) > precedence(op) ||
+                    (precedence((ExprOp)ops[oTop]) == precedence(op) && !isRightAssociative(op)))) {
+                emit(c, (ExprOp)ops[oTop--]);
+            }
+            expectOperand = true;
+        }
+
+        if (oTop + 1 >= OPSTACK_SIZE) {
+            error = "Expression too complex";
+            return false;
+        }
+        ops[++oTop] = op;
+    }
+
+    if (program.length == 0 && oTop < 0) {
+        error = "Empty expression";
+        return false;
+    }
+    if (expectOperand) {
+        error = "Invalid expression";
+        return false;
+    }
+
+    while (oTop >= 0) {
+        if (ops[oTop] == OPSTACK_PAREN) {
+            error = "Mismatched parentheses";
+            return false;
+        }
+        emit(c, (ExprOp)ops[oTop--]);
+    }
+
+    if (c.overflow) {
+        error = "Expression too long";
+        return false;
+    }
+
+    return true;
+}
+
+ExprStatus runExpression(const ExprProgram& program, float x, float& result) {
+    float stack[EXPR_MAX_STACK];
+    int top = -1;
+
+    for (uint8_t pc = 0; pc < program.length; pc++) {
+        const ExprInstr& in = program.code[pc];
+        switch (in.op) {
+            case EXPR_PUSH_CONST:
+                stack[++top] = in.value;
+                break;
+            case EXPR_PUSH_X:
+                stack[++top] = x;
+                break;
+            case EXPR_ADD: top--; stack[top] += stack[top + 1]; break;
+            case EXPR_SUB: top--; stack[top] -= stack[top + 1]; break;
+            case EXPR_MUL: top--; stack[top] *= stack[top + 1]; break;
+            case EXPR_DIV:
+            case EXPR_MOD:
+            case EXPR_POW: {
+                top--;
+                ExprStatus status = applyBinary(in.op, stack[top], stack[top + 1], stack[top]);
+                if (status != EXPR_OK) return status;
+                break;
+            }
+            default:
+                stack[top] = applyUnary(in.op, stack[top]);
+                break;
+        }
+    }
+
+    result = stack[0];
+    return EXPR_OK;
+}
+
+const char* exprStatusText(ExprStatus status) {
+    switch (status) {
+        case EXPR_ERR_DIV_ZERO: return "Division by zero";
+        case EXPR_ERR_MOD_ZERO: return "Modulo by zero";
+        default: return "OK";
+    }
+}
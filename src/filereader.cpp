@@ -0,0 +1,83 @@
+#include "filereader.h"
+
+// Line reader over one fixed block buffer. Lines are cut out of the buffer
+// into a fixed line array, so reading a file allocates nothing however many
+// lines it has; the old path built a String per line with
+// readStringUntil(). Reads go to the filesystem a whole block at a time.
+
+void lineReaderBegin(LineReader& r, File& file, size_t limit) {
+    r.file = &file;
+    r.remaining = limit;
+    r.pos = 0;
+    r.len = 0;
+}
+
+static bool refill(LineReader& r) {
+    if (r.remaining == 0) return false;
+    size_t want = r.remaining < FILE_READ_BUF ? r.remaining : FILE_READ_BUF;
+    int n = r.file->read(r.buf, want);
+    if (n <= 0) return false;
+    r.pos = 0;
+    r.len = n;
+    r.remaining -= n;
+    return true;
+}
+
+const char* lineReaderNext(LineReader& r, size_t* length) {
+    size_t out = 0;
+    bool any = false;
+
+    while (true) {
+        if (r.pos == r.len && !refill(r)) break;
+        any = true;
+
+        const uint8_t* start = r.buf + r.pos;
+        size_t avail = r.len - r.pos;
+        const uint8_t* nl = (const uint8_t*)memchr(start, '\n', avail);
+        size_t take = nl ? nl - start : avail;
+        if (take > FILE_LINE_MAX - out) take = FILE_LINE_MAX - out;
+
+        memcpy(r.line + out, start, take);
+        out += take;
+        r.pos += take;
+
+        if (nl && start + take == nl) {
+            r.pos++;
+            break;
+        }
+        if (out == FILE_LINE_MAX) {
+            if (r.pos < r.len && r.buf[r.pos] == '\n') r.pos++;
+            break;
+        }
+    }
+
+    if (!any) return NULL;
+    if (out > 0 && r.line[out - 1] == '\r') out--;
+    r.line[out] = '\0';
+    if (length) *length = out;
+    return r.line;
+}
+
+// Offset of the first of the last `lines` lines, found by scanning blocks
+// backwards from the end of the file. A newline as the very last byte ends
+// the last line rather than starting an empty one.
+size_t tailOffset(File& file, int lines) {
+    uint8_t buf[FILE_READ_BUF];
+    size_t size = file.size();
+    size_t end = size;
+    if (lines <= 0) return size;
+
+    while (end > 0) {
+        size_t start = end > FILE_READ_BUF ? end - FILE_READ_BUF : 0;
+        file.seek(start);
+        int n = file.read(buf, end - start);
+        if (n <= 0) break;
+
+        for (int i = n - 1; i >= 0; i--) {
+            if (buf[i] != '\n' || start + i == size - 1) continue;
+            if (--lines == 0) return start + i + 1;
+        }
+        end = start;
+    }
+    return 0;
+}
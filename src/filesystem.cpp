@@ -1,29 +1,34 @@
 #include "filesystem.h"
 #include "display.h"
 #include <FS.h>
-#include <SPIFFS.h>
+#include "vfs.h"
+#include "filereader.h"
+#include "tty.h"
+#include "fscache.h"
+#include "logchan.h"
+#include <esp_rom_crc.h>
 
 bool initFilesystem() {
-    if (!SPIFFS.begin(true)) {
-        printLine("SPIFFS Failed.");
+    if (!vfsMount()) {
+        printLine("Filesystem mount failed.");
         return false;
     }
+    fsCacheInit();
     
     
-    size_t total = SPIFFS.totalBytes();
-    size_t used = SPIFFS.usedBytes();
-    printLine("SPIFFS: " + String(used) + "/" + String(total) + " bytes");
+    size_t total = vfsTotalBytes();
+    size_t used = vfsUsedBytes();
+    printLine(String(vfsName()) + ": " + String(used) + "/" + String(total) + " bytes");
     
     return true;
 }
 
 void writeFile(String name, String data) {
    
-    if (!name.startsWith("/")) {
-        name = "/" + name;
-    }
+    name = vfsPath(name);
+    logSyncPath(name);
     
-    File f = SPIFFS.open(name, FILE_WRITE);
+    File f = vfs().open(name, FILE_WRITE);
     if (!f) {
         printLine("Error opening file.");
         return;
@@ -32,6 +37,7 @@ void writeFile(String name, String data) {
     size_t written = f.print(data);
     f.flush();  
     f.close();
+    fsCacheUpdate(name);
     
     if (written > 0) {
         printLine("Written " + String(written) + " bytes.");
@@ -42,11 +48,10 @@ void writeFile(String name, String data) {
 
 void appendFile(String name, String data) {
     
-    if (!name.startsWith("/")) {
-        name = "/" + name;
-    }
+    name = vfsPath(name);
+    logSyncPath(name);
     
-    File f = SPIFFS.open(name, FILE_APPEND);
+    File f = vfs().open(name, FILE_APPEND);
     if (!f) {
         printLine("Error opening file.");
         return;
@@ -55,6 +60,7 @@ void appendFile(String name, String data) {
     size_t written = f.print(data);
     f.flush(); 
     f.close();
+    fsCacheUpdate(name);
     
     if (written > 0) {
         printLine("Appended " + String(written) + " bytes.");
@@ -63,13 +69,20 @@ void appendFile(String name, String data) {
     }
 }
 
+static void printLines(LineReader& r, int maxLines = -1) {
+    const char* line;
+    while (maxLines != 0 && (line = lineReaderNext(r)) != NULL) {
+        printLine(line);
+        if (maxLines > 0) maxLines--;
+    }
+}
+
 void readFile(String name) {
     
-    if (!name.startsWith("/")) {
-        name = "/" + name;
-    }
+    name = vfsPath(name);
+    logSyncPath(name);
     
-    File f = SPIFFS.open(name);
+    File f = vfs().open(name);
     if (!f) {
         printLine("Error reading file.");
         return;
@@ -77,9 +90,9 @@ void readFile(String name) {
     
     if (f.available()) {
         printLine("File: " + name);
-        while (f.available()) {
-            printLine(f.readStringUntil('\n'));
-        }
+        LineReader reader;
+        lineReaderBegin(reader, f);
+        printLines(reader);
     } else {
         printLine("File is empty.");
     }
@@ -87,71 +100,338 @@ void readFile(String name) {
     f.close();
 }
 
+void readRange(String name, size_t offset, size_t length) {
+    name = vfsPath(name);
+    logSyncPath(name);
+
+    File f = vfs().open(name);
+    if (!f) {
+        printLine("Error reading file.");
+        return;
+    }
+
+    if (offset >= f.size()) {
+        printLine("Offset past end of file (" + String(f.size()) + " bytes).");
+        f.close();
+        return;
+    }
+
+    f.seek(offset);
+    LineReader reader;
+    lineReaderBegin(reader, f, length);
+    printLines(reader);
+    f.close();
+}
+
+void headFile(String name, int lines) {
+    name = vfsPath(name);
+    logSyncPath(name);
+
+    File f = vfs().open(name);
+    if (!f) {
+        printLine("Error reading file.");
+        return;
+    }
+
+    LineReader reader;
+    lineReaderBegin(reader, f);
+    printLines(reader, lines);
+    f.close();
+}
+
+void tailFile(String name, int lines) {
+    name = vfsPath(name);
+    logSyncPath(name);
+
+    File f = vfs().open(name);
+    if (!f) {
+        printLine("Error reading file.");
+        return;
+    }
+
+    f.seek(tailOffset(f, lines));
+    LineReader reader;
+    lineReaderBegin(reader, f);
+    printLines(reader);
+    f.close();
+}
+
+// Shows a page at a time; ENTER for the next page, q then ENTER to stop.
+void moreFile(String name) {
+    name = vfsPath(name);
+    logSyncPath(name);
+
+    File f = vfs().open(name);
+    if (!f) {
+        printLine("Error reading file.");
+        return;
+    }
+
+    size_t size = f.size();
+    LineReader reader;
+    lineReaderBegin(reader, f);
+    TtyLine input;
+
+    while (true) {
+        int shown = 0;
+        const char* line;
+        while (shown < FILE_PAGE_LINES && (line = lineReaderNext(reader)) != NULL) {
+            printLine(line);
+            shown++;
+        }
+        size_t done = f.position() - (reader.len - reader.pos);
+        if (shown < FILE_PAGE_LINES || done >= size) break;
+
+        int percent = done * 100 / size;
+        printLine("-- More -- (" + String(percent) + "%) ENTER: next page, q: quit");
+        ttyReadLine(input, portMAX_DELAY);
+        if (input.text[0] == 'q' || input.text[0] == 'Q') break;
+    }
+
+    f.close();
+}
+
+// Reads a file both ways without printing: a String per line through
+// readStringUntil() as readFile() used to, then the block line reader.
+void readBench(String name) {
+    name = vfsPath(name);
+    logSyncPath(name);
+
+    File f = vfs().open(name);
+    if (!f) {
+        printLine("Error reading file.");
+        return;
+    }
+    size_t size = f.size();
+    char line[80];
+
+    uint32_t start = micros();
+    size_t lines = 0;
+    while (f.available()) {
+        String s = f.readStringUntil('\n');
+        lines++;
+    }
+    uint32_t oldUs = micros() - start;
+    f.close();
+
+    f = vfs().open(name);
+    start = micros();
+    size_t newLines = 0;
+    LineReader reader;
+    lineReaderBegin(reader, f);
+    while (lineReaderNext(reader) != NULL) {
+        newLines++;
+    }
+    uint32_t newUs = micros() - start;
+    f.close();
+
+    sprintf(line, "%s: %u bytes, %u lines", name.c_str(), (unsigned)size, (unsigned)lines);
+    printLine(line);
+    sprintf(line, "readStringUntil: %7.1f ms  %6.3f MB/s", oldUs / 1000.0f,
+            oldUs ? size / (float)oldUs : 0.0f);
+    printLine(line);
+    sprintf(line, "line reader:     %7.1f ms  %6.3f MB/s", newUs / 1000.0f,
+            newUs ? size / (float)newUs : 0.0f);
+    printLine(line);
+    if (newLines != lines) {
+        sprintf(line, "Line counts differ: %u vs %u (lines over %d chars split)",
+                (unsigned)lines, (unsigned)newLines, FILE_LINE_MAX);
+        printLine(line);
+    }
+    if (oldUs && newUs) {
+        sprintf(line, "Speedup: %.1fx", oldUs / (float)newUs);
+        printLine(line);
+    }
+}
+
 void deleteFile(String name) {
     
-    if (!name.startsWith("/")) {
-        name = "/" + name;
-    }
+    name = vfsPath(name);
+    logSyncPath(name);
     
-    if (SPIFFS.remove(name)) {
+    if (vfs().remove(name)) {
+        fsCacheRemove(name);
         printLine("File deleted.");
     } else {
         printLine("Error deleting file.");
     }
 }
 
-void listFiles() {
-    size_t totalBytes = SPIFFS.totalBytes();
-    size_t usedBytes = SPIFFS.usedBytes();
-    printLine("SPIFFS: " + String(usedBytes) + "/" + String(totalBytes) + " bytes");
-    printLine("Files:");
-    
-    File root = SPIFFS.open("/");
+// Counts printed lines and asks before each new page; false once the user
+// typed q.
+static bool nextPageLine(int& shown) {
+    if (shown > 0 && shown % FILE_PAGE_LINES == 0) {
+        printLine("-- More -- ENTER: next page, q: quit");
+        TtyLine input;
+        ttyReadLine(input, portMAX_DELAY);
+        if (input.text[0] == 'q' || input.text[0] == 'Q') return false;
+    }
+    shown++;
+    return true;
+}
+
+static void printEntry(const FsEntry& e, const char* name, bool showTime) {
+    char when[20] = "";
+    if (showTime && e.mtime > 0) {
+        struct tm t;
+        localtime_r(&e.mtime, &t);
+        strftime(when, sizeof(when), "  %Y-%m-%d %H:%M", &t);
+    }
+    if (e.dir) {
+        printLine("  " + String(name) + "/" + when);
+    } else {
+        printLine("  " + String(name) + " - " + String(e.size) + " bytes" + when);
+    }
+}
+
+static void entryOf(File& f, FsEntry& e) {
+    e.path[0] = '\0';
+    e.dir = f.isDirectory();
+    e.size = e.dir ? 0 : f.size();
+    e.mtime = f.getLastWrite();
+}
+
+// Used when the partition has more entries than the cache holds: reads
+// the directory itself, in the order the filesystem returns it.
+static void listDirect(const String& dir, const String& pattern, bool showTime) {
+    File root = vfs().open(dir);
     if (!root) {
-        printLine("Failed to open root");
+        printLine("Failed to open " + dir);
         return;
     }
-    
-    bool found = false;
-    
-    while (true) {
-        File file = root.openNextFile();
-        if (!file) {
-            break;
+    printLine("  (more than " + String(FS_CACHE_MAX) + " entries, unsorted)");
+
+    size_t skip = dir == "/" ? 1 : dir.length() + 1;
+    int count = 0;
+    uint32_t bytes = 0;
+    int shown = 0;
+    while (File f = root.openNextFile()) {
+        String path = f.path();
+        const char* name = path.c_str() + skip;
+        if (pattern.length() == 0 || globMatch(pattern.c_str(), name)) {
+            if (!nextPageLine(shown)) {
+                f.close();
+                break;
+            }
+            FsEntry e;
+            entryOf(f, e);
+            printEntry(e, name, showTime);
+            count++;
+            bytes += e.size;
         }
-        
-        found = true;
-        String fileName = String(file.name());
-        
-        
-        if (fileName.startsWith("/")) {
-            fileName = fileName.substring(1);
+        f.close();
+    }
+    root.close();
+    printLine(String(count) + " entries, " + String(bytes) + " bytes");
+}
+
+// find without the cache; false once the user quit paging.
+static bool findDirect(const String& dir, const char* pattern, bool matchPath,
+                       int& shown, int& found) {
+    File root = vfs().open(dir);
+    if (!root) return true;
+
+    bool more = true;
+    while (more) {
+        File f = root.openNextFile();
+        if (!f) break;
+        String path = f.path();
+        const char* subject = matchPath ? path.c_str() : path.c_str() + path.lastIndexOf('/') + 1;
+        if (globMatch(pattern, subject)) {
+            more = nextPageLine(shown);
+            if (more) {
+                FsEntry e;
+                entryOf(f, e);
+                printEntry(e, path.c_str(), false);
+                found++;
+            }
         }
+        if (more && f.isDirectory()) more = findDirect(path, pattern, matchPath, shown, found);
+        f.close();
+    }
+    root.close();
+    return more;
+}
+
+// target is empty (working directory), a directory, or a name pattern
+// with '*' and '?', optionally inside a directory.
+void listFiles(String target, FsSort sort, int flags) {
+    size_t totalBytes = vfsTotalBytes();
+    size_t usedBytes = vfsUsedBytes();
+    printLine(String(vfsName()) + ": " + String(usedBytes) + "/" + String(totalBytes) + " bytes");
+    
+    String dir = vfsCwd();
+    String pattern = "";
+    if (target.length() > 0) {
+        String path = vfsPath(target);
+        File f = vfs().open(path);
+        bool isDir = f && f.isDirectory();
+        if (f) f.close();
         
-        if (fileName.length() > 0) {
-            printLine("  " + fileName + " - " + String(file.size()) + " bytes");
+        if (isDir || path == "/") {
+            dir = path;
+        } else {
+            int slash = path.lastIndexOf('/');
+            dir = slash > 0 ? path.substring(0, slash) : "/";
+            pattern = path.substring(slash + 1);
         }
-        
-        file.close();
     }
+    printLine(dir == "/" ? "Files:" : "Files in " + dir + ":");
     
-    if (!found) {
-        printLine("  (no files)");
+    int count;
+    FsEntry* list = fsCacheQuery(dir, pattern.length() ? pattern.c_str() : NULL, sort, flags, count);
+    if (count < 0) {
+        listDirect(dir, pattern, sort == FS_SORT_TIME);
+        return;
+    }
+    if (list == NULL) {
+        printLine(pattern.length() ? "  (no match)" : "  (no files)");
+        return;
     }
     
-    root.close();
+    size_t skip = dir == "/" ? 1 : dir.length() + 1;
+    uint32_t bytes = 0;
+    int shown = 0;
+    for (int i = 0; i < count; i++) {
+        if (!nextPageLine(shown)) break;
+        printEntry(list[i], list[i].path + skip, sort == FS_SORT_TIME);
+        bytes += list[i].size;
+    }
+    printLine(String(count) + " entries, " + String(bytes) + " bytes");
+    free(list);
 }
 
-bool renameFile(String oldName, String newName) {
-   
-    if (!oldName.startsWith("/")) {
-        oldName = "/" + oldName;
+// Every file or directory whose name matches pattern, in all directories.
+// A pattern containing '/' is matched against the whole path.
+void findFiles(String pattern) {
+    int count;
+    FsEntry* list = fsCacheQuery("/", pattern.c_str(), FS_SORT_NAME, FS_LIST_RECURSIVE, count);
+    if (count < 0) {
+        int shown = 0;
+        count = 0;
+        findDirect("/", pattern.c_str(), pattern.indexOf('/') >= 0, shown, count);
+        printLine(String(count) + (count == 1 ? " match" : " matches") + ", unsorted");
+        return;
     }
-    if (!newName.startsWith("/")) {
-        newName = "/" + newName;
+    
+    int shown = 0;
+    for (int i = 0; i < count; i++) {
+        if (!nextPageLine(shown)) break;
+        printEntry(list[i], list[i].path, false);
     }
+    printLine(String(count) + (count == 1 ? " match" : " matches"));
+    free(list);
+}
+
+bool renameFile(String oldName, String newName) {
+   
+    oldName = vfsPath(oldName);
+    newName = vfsPath(newName);
+    logSyncPath(oldName);
+    logSyncPath(newName);
     
-    if (SPIFFS.rename(oldName, newName)) {
+    if (vfs().rename(oldName, newName)) {
+        fsCacheRename(oldName, newName);
         printLine("Renamed.");
         return true;
     }
@@ -160,38 +440,118 @@ bool renameFile(String oldName, String newName) {
     return false;
 }
 
-bool copyFile(String src, String dst) {
-    
-    if (!src.startsWith("/")) {
-        src = "/" + src;
+// Copies through one FS_COPY_BUF buffer, a whole number of flash pages, so
+// SPIFFS writes full pages instead of rewriting a partly filled one for
+// every small chunk. A CRC32 of the source is kept as the data passes; with
+// verify the copy is read back and must give the same CRC.
+bool fsCopy(const char* src, const char* dst, bool verify, FsCopyResult* result,
+            FsProgress progress, void* ctx) {
+    FsCopyResult local;
+    if (result == NULL) result = &local;
+    memset(result, 0, sizeof(*result));
+    if (strcmp(src, dst) == 0) return false;
+
+    File in = vfs().open(src);
+    if (!in) return false;
+
+    File out = vfs().open(dst, FILE_WRITE);
+    if (!out) {
+        in.close();
+        return false;
     }
-    if (!dst.startsWith("/")) {
-        dst = "/" + dst;
+
+    uint8_t* buf = (uint8_t*)malloc(FS_COPY_BUF);
+    if (buf == NULL) {
+        in.close();
+        out.close();
+        return false;
     }
+
+    size_t total = in.size();
+    uint32_t start = millis();
+    uint32_t crc = 0;
+    bool ok = true;
+
+    while (true) {
+        int len = in.read(buf, FS_COPY_BUF);
+        if (len <= 0) break;
+        crc = esp_rom_crc32_le(crc, buf, len);
+        if (out.write(buf, len) != (size_t)len) {
+            ok = false;
+            break;
+        }
+        result->bytes += len;
+        if (progress) progress(result->bytes, total, ctx);
+    }
+
+    in.close();
+    out.close();
+    fsCacheUpdate(dst);
+    result->crc = crc;
+    result->elapsedMs = millis() - start;
+
+    if (ok && verify) {
+        File check = vfs().open(dst);
+        uint32_t readCrc = 0;
+        size_t readBytes = 0;
+        int len;
+        while (check && (len = check.read(buf, FS_COPY_BUF)) > 0) {
+            readCrc = esp_rom_crc32_le(readCrc, buf, len);
+            readBytes += len;
+        }
+        if (check) check.close();
+        result->verified = readCrc == crc && readBytes == result->bytes;
+        ok = result->verified;
+    }
+
+    free(buf);
+    return ok && result->bytes == total;
+}
+
+static void copyProgress(size_t done, size_t total, void* ctx) {
+    uint32_t* last = (uint32_t*)ctx;
+    if (done < total && millis() - *last < FS_PROGRESS_MS) return;
+    *last = millis();
+
+    char line[64];
+    sprintf(line, "  %3u%%  %u/%u bytes", total ? (unsigned)(done * 100 / total) : 100,
+            (unsigned)done, (unsigned)total);
+    printLine(line);
+}
+
+bool copyFile(String src, String dst, bool verify) {
     
-    File in = SPIFFS.open(src);
-    if (!in) {
+    src = vfsPath(src);
+    dst = vfsPath(dst);
+    logSyncPath(src);
+    logSyncPath(dst);
+    
+    if (!vfs().exists(src)) {
         printLine("Error reading src file.");
         return false;
     }
     
-    File out = SPIFFS.open(dst, FILE_WRITE);
-    if (!out) {
-        in.close();
-        printLine("Error opening dst file.");
-        return false;
-    }
+    FsCopyResult result;
+    uint32_t lastProgress = millis();
+    bool ok = fsCopy(src.c_str(), dst.c_str(), verify, &result, copyProgress, &lastProgress);
     
-    uint8_t buf[64];
-    while (in.available()) {
-        int len = in.read(buf, sizeof(buf));
-        out.write(buf, len);
+    char line[80];
+    if (!ok) {
+        if (verify && result.bytes > 0 && !result.verified) {
+            sprintf(line, "Verify failed: copy does not match CRC32 %08lx.",
+                    (unsigned long)result.crc);
+            printLine(line);
+        } else {
+            printLine("Copy failed after " + String(result.bytes) + " bytes.");
+        }
+        return false;
     }
     
-    in.close();
-    out.flush();  
-    out.close();
-    
-    printLine("Copied.");
+    float kbps = result.elapsedMs ? result.bytes / 1.024f / result.elapsedMs : 0;
+    sprintf(line, "Copied %u bytes in %lu ms (%.1f KB/s)", (unsigned)result.bytes,
+            (unsigned long)result.elapsedMs, kbps);
+    printLine(line);
+    sprintf(line, "CRC32 %08lx%s", (unsigned long)result.crc, verify ? " verified" : "");
+    printLine(line);
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,76 @@
+#include "fixmath.h"
+#include <math.h>
+
+// Table-driven fixed-point helpers for code that runs per pixel. The tables
+// are filled once by fixInit(); after that nothing here touches floats.
+
+#define ATAN_STEPS 256
+
+static int16_t sinTable[FIX_TURN];
+static uint8_t sin8Table[256];
+static uint8_t atanTable[ATAN_STEPS + 1];
+static bool ready = false;
+
+void fixInit() {
+    if (ready) return;
+
+    for (int i = 0; i < FIX_TURN; i++) {
+        sinTable[i] = (int16_t)lroundf(sinf(i * 2.0f * M_PI / FIX_TURN) * FIX_ONE);
+    }
+    for (int i = 0; i < 256; i++) {
+        sin8Table[i] = (uint8_t)((sinf(i * M_PI / 128.0f) + 1.0f) * 127.5f);
+    }
+    // atan(t) for t in [0, 1], in angle units (0..FIX_TURN/8)
+    for (int i = 0; i <= ATAN_STEPS; i++) {
+        atanTable[i] = (uint8_t)lroundf(atanf((float)i / ATAN_STEPS) * FIX_TURN / (2.0f * M_PI));
+    }
+    ready = true;
+}
+
+int16_t fixSin(int angle) {
+    return sinTable[angle & (FIX_TURN - 1)];
+}
+
+int16_t fixCos(int angle) {
+    return sinTable[(angle + FIX_QUARTER_TURN) & (FIX_TURN - 1)];
+}
+
+// Same wave as the old (sin(angle * PI / 128) + 1) * 127.5, period 256.
+uint8_t sin8(int angle) {
+    return sin8Table[angle & 255];
+}
+
+// Signed angle of (x, y) in -FIX_HALF_TURN..FIX_HALF_TURN, like atan2(y, x).
+// Reduced to the first octant so one table covers the whole circle.
+int fixAtan2(int y, int x) {
+    if (x == 0 && y == 0) return 0;
+
+    int ax = x < 0 ? -x : x;
+    int ay = y < 0 ? -y : y;
+    int a;
+    if (ay <= ax) {
+        a = atanTable[(ay * ATAN_STEPS + ax / 2) / ax];
+    } else {
+        a = FIX_QUARTER_TURN - atanTable[(ax * ATAN_STEPS + ay / 2) / ay];
+    }
+
+    if (x < 0) a = FIX_HALF_TURN - a;
+    return y < 0 ? -a : a;
+}
+
+uint16_t fixSqrt(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
@@ -0,0 +1,250 @@
+#include "fscache.h"
+#include "vfs.h"
+#include <freertos/semphr.h>
+
+// Name, size and modification time of every file and directory, so ls and
+// find work from memory instead of opening each file on flash. The table
+// is built by one walk of the partition the first time it is needed and
+// then kept current by the code paths that write, append, copy, rename or
+// delete files. Anything that changes many files at once just invalidates
+// it and the next listing walks the partition again. A partition with more
+// than FS_CACHE_MAX entries is not walked again until files are removed or
+// the cache is invalidated; callers list such partitions directly.
+
+static FsEntry* entries = NULL;
+static int count = 0;
+static int capacity = 0;
+static bool valid = false;
+static bool overflow = false;
+static SemaphoreHandle_t cacheMutex = NULL;
+
+static void lockCache() {
+    xSemaphoreTake(cacheMutex, portMAX_DELAY);
+}
+
+static void unlockCache() {
+    xSemaphoreGive(cacheMutex);
+}
+
+void fsCacheInit() {
+    if (cacheMutex == NULL) cacheMutex = xSemaphoreCreateMutex();
+}
+
+static void clear() {
+    free(entries);
+    entries = NULL;
+    count = 0;
+    capacity = 0;
+    valid = false;
+}
+
+void fsCacheInvalidate() {
+    lockCache();
+    clear();
+    overflow = false;
+    unlockCache();
+}
+
+static int find(const char* path) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(entries[i].path, path) == 0) return i;
+    }
+    return -1;
+}
+
+static FsEntry* append() {
+    if (count == capacity) {
+        if (capacity >= FS_CACHE_MAX) return NULL;
+        int grown = capacity + FS_CACHE_GROW;
+        FsEntry* bigger = (FsEntry*)realloc(entries, grown * sizeof(FsEntry));
+        if (bigger == NULL) return NULL;
+        entries = bigger;
+        capacity = grown;
+    }
+    return &entries[count++];
+}
+
+// False when the table is full; the cache is then dropped and queries
+// report it rather than return a partial listing.
+static bool store(File& f) {
+    String path = f.path();
+    if (path.length() >= FS_PATH_MAX) return true;
+
+    int i = find(path.c_str());
+    FsEntry* e = i >= 0 ? &entries[i] : append();
+    if (e == NULL) return false;
+
+    strlcpy(e->path, path.c_str(), sizeof(e->path));
+    e->dir = f.isDirectory();
+    e->size = e->dir ? 0 : f.size();
+    e->mtime = f.getLastWrite();
+    return true;
+}
+
+static bool walk(const String& dir) {
+    File root = vfs().open(dir);
+    if (!root) return false;
+
+    bool ok = true;
+    while (ok) {
+        File f = root.openNextFile();
+        if (!f) break;
+        ok = store(f);
+        if (ok && f.isDirectory()) ok = walk(f.path());
+        f.close();
+    }
+    root.close();
+    return ok;
+}
+
+// Caller holds cacheMutex.
+static bool ensureBuilt() {
+    if (valid) return true;
+    if (overflow) return false;
+    clear();
+    valid = walk("/");
+    if (!valid) {
+        clear();
+        overflow = true;
+    }
+    return valid;
+}
+
+void fsCacheUpdate(const String& path) {
+    lockCache();
+    if (valid) {
+        File f = vfs().open(path);
+        if (f) {
+            if (!store(f)) {
+                clear();
+                overflow = true;
+            }
+            f.close();
+        } else {
+            int i = find(path.c_str());
+            if (i >= 0) entries[i] = entries[--count];
+        }
+    }
+    unlockCache();
+}
+
+static bool isUnder(const char* path, const String& dir) {
+    size_t n = dir.length();
+    return strncmp(path, dir.c_str(), n) == 0 && path[n] == '/';
+}
+
+// Caller holds cacheMutex.
+static void removeLocked(const String& path) {
+    for (int i = 0; i < count; ) {
+        if (strcmp(entries[i].path, path.c_str()) == 0 || isUnder(entries[i].path, path)) {
+            entries[i] = entries[--count];
+        } else {
+            i++;
+        }
+    }
+}
+
+void fsCacheRemove(const String& path) {
+    lockCache();
+    removeLocked(path);
+    // Fewer entries now; an oversized partition may fit again.
+    overflow = false;
+    unlockCache();
+}
+
+void fsCacheRename(const String& from, const String& to) {
+    lockCache();
+    // rename replaces an existing target
+    removeLocked(to);
+    for (int i = 0; i < count; i++) {
+        FsEntry& e = entries[i];
+        if (strcmp(e.path, from.c_str()) == 0) {
+            strlcpy(e.path, to.c_str(), sizeof(e.path));
+        } else if (isUnder(e.path, from)) {
+            String moved = to + String(e.path + from.length());
+            strlcpy(e.path, moved.c_str(), sizeof(e.path));
+        }
+    }
+    unlockCache();
+    fsCacheUpdate(to);
+}
+
+// '*' matches any run of characters, '?' any one.
+bool globMatch(const char* pattern, const char* name) {
+    const char* star = NULL;
+    const char* resume = NULL;
+    while (*name) {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = name;
+        } else if (*pattern == '?' || *pattern == *name) {
+            pattern++;
+            name++;
+        } else if (star) {
+            pattern = star + 1;
+            name = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
+
+static FsSort sortKey;
+static bool sortReverse;
+
+static int compareEntries(const void* a, const void* b) {
+    const FsEntry* x = (const FsEntry*)a;
+    const FsEntry* y = (const FsEntry*)b;
+    int order = 0;
+    if (sortKey == FS_SORT_SIZE) order = (x->size < y->size) - (x->size > y->size);
+    else if (sortKey == FS_SORT_TIME) order = (x->mtime < y->mtime) - (x->mtime > y->mtime);
+    if (order == 0) order = strcmp(x->path, y->path);
+    return sortReverse ? -order : order;
+}
+
+FsEntry* fsCacheQuery(const String& dir, const char* pattern, FsSort sort, int flags,
+                      int& found) {
+    found = 0;
+    lockCache();
+    if (!ensureBuilt()) {
+        unlockCache();
+        found = -1;
+        return NULL;
+    }
+
+    FsEntry* out = (FsEntry*)malloc((count ? count : 1) * sizeof(FsEntry));
+    if (out == NULL) {
+        unlockCache();
+        return NULL;
+    }
+
+    String prefix = dir == "/" ? "" : dir;
+    bool matchPath = pattern && strchr(pattern, '/');
+    for (int i = 0; i < count; i++) {
+        const FsEntry& e = entries[i];
+        if (!isUnder(e.path, prefix)) continue;
+
+        const char* rel = e.path + prefix.length() + 1;
+        if (!(flags & FS_LIST_RECURSIVE) && vfsHasDirs() && strchr(rel, '/')) continue;
+
+        if (pattern) {
+            const char* base = strrchr(e.path, '/') + 1;
+            const char* subject = matchPath ? e.path : (flags & FS_LIST_RECURSIVE) ? base : rel;
+            if (!globMatch(pattern, subject)) continue;
+        }
+        out[found++] = e;
+    }
+    unlockCache();
+
+    if (found == 0) {
+        free(out);
+        return NULL;
+    }
+
+    sortKey = sort;
+    sortReverse = flags & FS_LIST_REVERSE;
+    qsort(out, found, sizeof(FsEntry), compareEntries);
+    return out;
+}
@@ -3,149 +3,61 @@
 #include "config.h"
 #include "grapher.h"
 #include "commands.h"
+#include "expr.h"
+#include "tty.h"
 #include <cmath>
 
-#define E 2.71828182845904523536
-#define PI 3.14159265358979323846
+#define GRAPH_X_MIN -10.0f
+#define GRAPH_X_MAX 10.0f
 
-bool evaluateWithX(String expression, float xValue, float& result) {
-    // We need to be careful not to replace 'x' in function names like 'exp'
-    String expr = "";
-    for (int i = 0; i < expression.length(); i++) {
-        if (expression[i] == 'x') {
-            bool isStandalone = true;
-            if (i > 0 && (isalpha(expression[i-1]) || isdigit(expression[i-1]))) {
-                isStandalone = false;
-            }
-            if (i < expression.length() - 1 && (isalpha(expression[i+1]) || isdigit(expression[i+1]))) {
-                isStandalone = false;
-            }
-            
-            if (isStandalone) {
-                expr += "(" + String(xValue, 6) + ")";
-            } else {
-                expr += "x";
-            }
-        } else {
-            expr += expression[i];
-        }
-    }
-    
-    // Now we can use the existing calc logic from commands.cpp
-    expr.replace(" ", "");
-    expr.replace("pi", String(PI, 10));
-    expr.replace("e", String(E, 10));
-    
-    if (expr.length() == 0) {
-        return false;
+void benchGraph(String expression) {
+    ExprProgram program;
+    String error;
+
+    unsigned long t0 = micros();
+    if (!compileExpression(expression.c_str(), true, program, error)) {
+        printLine("Error: " + error);
+        return;
     }
-    
-    float values[50];
-    char ops[50];
-    String functions[50];
-    int vTop = -1;
-    int oTop = -1;
-    int fTop = -1;
-    int n = expr.length();
-    
-    for (int i = 0; i < n; i++) {
-        String funcName = getFunctionName(expr, i);
-        if (funcName.length() > 0) {
-            i += funcName.length();
-            functions[++fTop] = funcName;
-            continue;
-        }
-        
-        if (expr[i] == '(') {
-            ops[++oTop] = '(';
-        }
-        else if (expr[i] == ')') {
-            while (oTop >= 0 && ops[oTop] != '(') {
-                if (vTop < 1) return false;
-                float b = values[vTop--];
-                float a = values[vTop--];
-                char op = ops[oTop--];
-                values[++vTop] = applyOp(a, b, op);
-            }
-            if (oTop >= 0) oTop--;
-            
-            if (fTop >= 0) {
-                if (vTop < 0) return false;
-                float val = values[vTop--];
-                val = applyFunction(functions[fTop--], val);
-                values[++vTop] = val;
-            }
-        }
-        else if (isdigit(expr[i]) || expr[i] == '.') {
-            float num = 0;
-            float decimal = 0;
-            bool hasDecimal = false;
-            int decimalPlaces = 0;
-            
-            while (i < n && (isdigit(expr[i]) || expr[i] == '.')) {
-                if (expr[i] == '.') {
-                    if (hasDecimal) return false;
-                    hasDecimal = true;
-                } else {
-                    if (hasDecimal) {
-                        decimal = decimal * 10 + (expr[i] - '0');
-                        decimalPlaces++;
-                    } else {
-                        num = num * 10 + (expr[i] - '0');
-                    }
-                }
-                i++;
-            }
-            i--;
-            
-            if (hasDecimal && decimalPlaces > 0) {
-                num += decimal / pow(10, decimalPlaces);
-            }
-            values[++vTop] = num;
-        }
-        else if (expr[i] == '-' && (i == 0 || expr[i-1] == '(' || 
-                 expr[i-1] == '+' || expr[i-1] == '-' || 
-                 expr[i-1] == '*' || expr[i-1] == '/' || 
-                 expr[i-1] == '^')) {
-            values[++vTop] = 0;
-            ops[++oTop] = '-';
-        }
-        else if (expr[i] == '+' || expr[i] == '-' || 
-                 expr[i] == '*' || expr[i] == '/' || 
-                 expr[i] == '%' || expr[i] == '^') {
-            while (oTop >= 0 && ops[oTop] != '(' && 
-                   (precedence(ops[oTop]) > precedence(expr[i]) || 
-                   (precedence(ops[oTop]) == precedence(expr[i]) && 
-                    !isRightAssociative(expr[i])))) {
-                if (vTop < 1) return false;
-                float b = values[vTop--];
-                float a = values[vTop--];
-                char op = ops[oTop--];
-                values[++vTop] = applyOp(a, b, op);
+    unsigned long compileTime = micros() - t0;
+
+    printLine("Compiled to " + String(program.length) + " ops in " + String(compileTime) + " us");
+
+    const int sampleCounts[] = {320, 1280, 10000};
+    for (int s = 0; s < 3; s++) {
+        int samples = sampleCounts[s];
+        float step = (GRAPH_X_MAX - GRAPH_X_MIN) / samples;
+        volatile float sink = 0;
+        int failed = 0;
+
+        t0 = micros();
+        for (int i = 0; i < samples; i++) {
+            float y;
+            if (runExpression(program, GRAPH_X_MIN + i * step, y) == EXPR_OK) {
+                sink = y;
+            } else {
+                failed++;
             }
-            ops[++oTop] = expr[i];
-        }
-        else {
-            return false;
         }
+        unsigned long elapsed = micros() - t0;
+        (void)sink;
+
+        char line[80];
+        sprintf(line, "%5d samples: %7lu us  %.2f us/sample%s",
+                samples, elapsed, (float)elapsed / samples,
+                failed > 0 ? " (gaps)" : "");
+        printLine(line);
     }
-    
-    while (oTop >= 0) {
-        if (ops[oTop] == '(') return false;
-        if (vTop < 1) return false;
-        float b = values[vTop--];
-        float a = values[vTop--];
-        char op = ops[oTop--];
-        values[++vTop] = applyOp(a, b, op);
-    }
-    
-    if (vTop != 0) return false;
-    
-    result = values[vTop];
-    return true;
 }
 
 void funcToGraph(String expression, String lineColour) {
+    ExprProgram program;
+    String error;
+    if (!compileExpression(expression.c_str(), true, program, error)) {
+        printLine("Error: " + error);
+        return;
+    }
+
     screenLocked = true;
     
     tft.fillScreen(ST77XX_WHITE);
@@ -154,8 +66,8 @@ void funcToGraph(String expression, String lineColour) {
     const int screenWidth = 320;
     const int screenHeight = 230;
     
-    const float xMin = -10.0;
-    const float xMax = 10.0;
+    const float xMin = GRAPH_X_MIN;
+    const float xMax = GRAPH_X_MAX;
     const float yMin = -10.0;
     const float yMax = 10.0;
     
@@ -212,7 +124,7 @@ void funcToGraph(String expression, String lineColour) {
         float mathX = (px - centerX) / pixelsPerUnit;
         
         float mathY;
-        if (evaluateWithX(expression, mathX, mathY)) {
+        if (runExpression(program, mathX, mathY) == EXPR_OK) {
             if (isnan(mathY) || isinf(mathY)) {
                 prevY = NAN;
                 continue;
@@ -251,17 +163,9 @@ void funcToGraph(String expression, String lineColour) {
     tft.print("Press ENTER to exit");
     
     
-    while (true) {
-        if (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n') {
-                screenLocked = false;
-                applyTheme();
-                clearScreen();
-                tft.print("> ");
-                break;
-            }
-        }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-    }
+    TtyLine line;
+    ttyReadLine(line, portMAX_DELAY);
+    
+    screenLocked = false;
+    applyTheme();
 }
\ No newline at end of file
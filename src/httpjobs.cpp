@@ -0,0 +1,394 @@
+#include "httpjobs.h"
+#include "vfs.h"
+#include "fscache.h"
+#include "httppool.h"
+#include "httpstream.h"
+#include "display.h"
+#include "kernel.h"
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+
+// Background curl: "curl ... &" puts a job on jobQueue and returns at once.
+// A small pool of worker processes runs the requests through the HTTP
+// connection pool and stores status, headers and body in the job slot; a
+// body that outgrows the slot's buffer continues in /job<id>.out. Without
+// -o only the CURL_DISPLAY_LIMIT bytes fg can show are kept. "fg" prints a
+// finished job and frees its slot.
+
+static CurlJob jobs[CURL_MAX_JOBS];
+static QueueHandle_t jobQueue = NULL;
+static SemaphoreHandle_t jobMutex = NULL;
+static EventGroupHandle_t jobEvents = NULL;   // bit per slot, set when finished
+static int nextJobId = 1;
+
+struct JobSink {
+    CurlJob* job;
+    File file;
+};
+
+#define JOB_BIT(slot) ((EventBits_t)1 << (slot))
+
+static CurlJob* findJob(int id) {
+    for (int i = 0; i < CURL_MAX_JOBS; i++) {
+        if (jobs[i].state != JOB_FREE && jobs[i].id == id) return &jobs[i];
+    }
+    return NULL;
+}
+
+static bool jobSink(const uint8_t* data, size_t len, void* ctx) {
+    JobSink* sink = (JobSink*)ctx;
+    CurlJob* job = sink->job;
+
+    if (!sink->file && job->bytes + len > CURL_JOB_INLINE) {
+        String path = "/job" + String(job->id) + ".out";
+        sink->file = vfs().open(path, FILE_WRITE);
+        if (!sink->file) return false;
+        if (sink->file.write((const uint8_t*)job->body, job->bytes) != job->bytes) return false;
+        job->spillPath = path;
+    }
+
+    if (sink->file) {
+        if (sink->file.write(data, len) != len) return false;
+    } else {
+        memcpy(job->body + job->bytes, data, len);
+    }
+    job->bytes += len;
+    return true;
+}
+
+static void saveHeaders(HTTPClient& http, CurlJob* job) {
+    size_t used = 0;
+    job->headers[0] = '\0';
+    for (size_t i = 0; i < httpStreamHeaderCount; i++) {
+        const char* name = httpStreamHeaders[i];
+        if (!http.hasHeader(name)) continue;
+        int n = snprintf(job->headers + used, sizeof(job->headers) - used, "%s: %s\n",
+                         name, http.header(name).c_str());
+        if (n < 0 || used + n >= sizeof(job->headers)) break;
+        used += n;
+    }
+}
+
+static CurlJobState runJob(CurlJob* job) {
+    const CurlOptions& opts = job->opts;
+    String url = opts.url;
+    unsigned long start = millis();
+
+    HTTPClient* http = httpAcquire(url);
+    int code = 0;
+    for (int hop = 0; http != NULL; hop++) {
+        http->setTimeout(opts.timeout);
+        http->setUserAgent(opts.userAgent);
+        for (int i = 0; i < opts.headerCount; i++) {
+            int colonPos = opts.headers[i].indexOf(':');
+            if (colonPos > 0) {
+                String value = opts.headers[i].substring(colonPos + 1);
+                value.trim();
+                http->addHeader(opts.headers[i].substring(0, colonPos), value);
+            }
+        }
+
+        if (opts.method == "POST") {
+            code = http->POST(opts.data);
+        } else if (opts.method == "PUT") {
+            code = http->PUT(opts.data);
+        } else if (opts.method == "DELETE") {
+            code = http->sendRequest("DELETE");
+        } else {
+            code = http->GET();
+        }
+
+        if (!opts.followRedirects || opts.method != "GET" || hop >= HTTP_MAX_REDIRECTS ||
+            !httpRedirect(http, code, url)) {
+            break;
+        }
+    }
+
+    if (http == NULL) {
+        job->error = "no free connection";
+        job->durationMs = millis() - start;
+        return JOB_FAILED;
+    }
+    if (code <= 0) {
+        job->error = http->errorToString(code);
+        httpRelease(http, false);
+        job->durationMs = millis() - start;
+        return JOB_FAILED;
+    }
+
+    job->code = code;
+    job->length = http->getSize();
+    saveHeaders(*http, job);
+
+    JobSink sink;
+    sink.job = job;
+    size_t limit = CURL_DISPLAY_LIMIT;
+    if (opts.outFile.length() > 0) {
+        limit = 0;
+        job->spillPath = vfsPath(opts.outFile);
+        sink.file = vfs().open(job->spillPath, FILE_WRITE);
+        if (!sink.file) {
+            job->error = "cannot open " + job->spillPath;
+            job->spillPath = "";
+            httpRelease(http, false);
+            job->durationMs = millis() - start;
+            return JOB_FAILED;
+        }
+    }
+
+    HttpStreamResult result;
+    httpStreamBody(*http, jobSink, &sink, limit, result);
+    if (sink.file) {
+        sink.file.close();
+        fsCacheUpdate(job->spillPath);
+    }
+    httpRelease(http, result.complete);
+
+    job->complete = result.complete;
+    job->truncated = !result.complete && limit && result.bytes >= limit;
+    if (!result.complete && !job->truncated) {
+        job->error = result.timedOut ? "timed out reading body" : "transfer incomplete";
+    }
+    job->durationMs = millis() - start;
+    return JOB_DONE;
+}
+
+static void curlWorker(void* parameter) {
+    int slot;
+    while (1) {
+        if (xQueueReceive(jobQueue, &slot, portMAX_DELAY) != pdTRUE) continue;
+
+        CurlJob* job = &jobs[slot];
+        xSemaphoreTake(jobMutex, portMAX_DELAY);
+        job->state = JOB_RUNNING;
+        xSemaphoreGive(jobMutex);
+
+        CurlJobState state = runJob(job);
+
+        // Report before publishing the state: fg frees the slot as soon as
+        // it sees the job finish.
+        char line[80];
+        if (state == JOB_DONE) {
+            snprintf(line, sizeof(line), "[%d] Done  HTTP %d  %s", job->id, job->code,
+                     formatBytes(job->bytes).c_str());
+        } else {
+            snprintf(line, sizeof(line), "[%d] Failed  %s", job->id, job->error.c_str());
+        }
+        printLine(line);
+
+        xSemaphoreTake(jobMutex, portMAX_DELAY);
+        job->state = state;
+        xSemaphoreGive(jobMutex);
+        xEventGroupSetBits(jobEvents, JOB_BIT(slot));
+    }
+}
+
+static bool startWorkers() {
+    if (jobQueue != NULL) return true;
+
+    jobMutex = xSemaphoreCreateMutex();
+    jobEvents = xEventGroupCreate();
+    jobQueue = xQueueCreate(CURL_MAX_JOBS, sizeof(int));
+    if (jobMutex == NULL || jobEvents == NULL || jobQueue == NULL) return false;
+
+    for (int i = 0; i < CURL_WORKERS; i++) {
+        if (createProcess(curlWorker, "curlw", CURL_WORKER_STACK, 1) < 0) {
+            return i > 0;
+        }
+    }
+    return true;
+}
+
+// Queues opts for a worker and returns the job id, or -1.
+int curlSubmit(const CurlOptions& opts) {
+    if (!startWorkers()) {
+        printLine("curl: cannot start workers");
+        return -1;
+    }
+
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    int slot = -1;
+    for (int i = 0; i < CURL_MAX_JOBS; i++) {
+        if (jobs[i].state == JOB_FREE) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        xSemaphoreGive(jobMutex);
+        printLine("curl: job table full, collect results with 'fg'");
+        return -1;
+    }
+
+    CurlJob& job = jobs[slot];
+    job.id = nextJobId++;
+    job.opts = opts;
+    job.code = 0;
+    job.durationMs = 0;
+    job.bytes = 0;
+    job.length = -1;
+    job.complete = false;
+    job.truncated = false;
+    job.headers[0] = '\0';
+    job.spillPath = "";
+    job.error = "";
+    job.state = JOB_QUEUED;
+    int id = job.id;
+    xEventGroupClearBits(jobEvents, JOB_BIT(slot));
+    xSemaphoreGive(jobMutex);
+
+    xQueueSend(jobQueue, &slot, portMAX_DELAY);
+    return id;
+}
+
+static const char* jobStateName(CurlJobState state) {
+    switch (state) {
+        case JOB_QUEUED:  return "Queued";
+        case JOB_RUNNING: return "Running";
+        case JOB_DONE:    return "Done";
+        case JOB_FAILED:  return "Failed";
+        default:          return "";
+    }
+}
+
+void listJobs() {
+    if (jobMutex == NULL) {
+        printLine("No jobs");
+        return;
+    }
+
+    char line[80];
+    int shown = 0;
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    for (int i = 0; i < CURL_MAX_JOBS; i++) {
+        CurlJob& job = jobs[i];
+        if (job.state == JOB_FREE) continue;
+
+        if (job.state == JOB_DONE) {
+            snprintf(line, sizeof(line), "[%d] %-7s %3d %8s %.28s", job.id,
+                     jobStateName(job.state), job.code, formatBytes(job.bytes).c_str(),
+                     job.opts.url.c_str());
+        } else {
+            snprintf(line, sizeof(line), "[%d] %-7s %.40s", job.id,
+                     jobStateName(job.state), job.opts.url.c_str());
+        }
+        printLine(line);
+        shown++;
+    }
+    xSemaphoreGive(jobMutex);
+
+    if (shown == 0) printLine("No jobs");
+}
+
+static void printSpilledBody(const String& path, size_t limit) {
+    File f = vfs().open(path, FILE_READ);
+    if (!f) {
+        printLine("fg: cannot open " + path);
+        return;
+    }
+
+    PrintSinkState state;
+    state.length = 0;
+    uint8_t buf[HTTP_STREAM_BUF];
+    size_t printed = 0;
+    while (printed < limit) {
+        size_t want = min(sizeof(buf), limit - printed);
+        int n = f.read(buf, want);
+        if (n <= 0) break;
+        printSink(buf, n, &state);
+        printed += n;
+    }
+    printSinkFlush(state);
+    f.close();
+}
+
+// Waits for job id to finish, prints it the way a foreground curl would
+// and frees the slot. A spill file is removed unless it was asked for
+// with -o.
+void foregroundJob(int id) {
+    if (jobMutex == NULL) {
+        printLine("fg: no such job");
+        return;
+    }
+
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    CurlJob* job = findJob(id);
+    bool pending = job && (job->state == JOB_QUEUED || job->state == JOB_RUNNING);
+    xSemaphoreGive(jobMutex);
+    if (job == NULL) {
+        printLine("fg: no such job: " + String(id));
+        return;
+    }
+
+    if (pending) {
+        printLine("[" + String(id) + "] " + job->opts.url);
+        xEventGroupWaitBits(jobEvents, JOB_BIT(job - jobs), pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+
+    const CurlOptions& opts = job->opts;
+    if (job->state == JOB_FAILED) {
+        printLine("curl: " + job->error);
+    } else {
+        printLine("HTTP " + String(job->code) + " - " + String(job->durationMs) + "ms");
+
+        if (opts.verbose) {
+            char* p = job->headers;
+            while (*p) {
+                char* end = strchr(p, '\n');
+                if (end) *end = '\0';
+                printLine("< " + String(p));
+                if (!end) break;
+                p = end + 1;
+            }
+            printLine("");
+        }
+
+        String contentType = "";
+        char* ct = strstr(job->headers, "Content-Type: ");
+        if (ct) {
+            contentType = String(ct + 14);
+            int nl = contentType.indexOf('\n');
+            if (nl >= 0) contentType = contentType.substring(0, nl);
+        }
+
+        if (opts.outFile.length() > 0) {
+            printLine("Saved " + formatBytes(job->bytes) + " to " + job->spillPath);
+        } else if (isBinaryContent(contentType)) {
+            size_t size = job->length >= 0 ? job->length : job->bytes;
+            printLine("Binary content (" + contentType + "), " + formatBytes(size));
+        } else if (job->bytes == 0) {
+            printLine("(empty response)");
+        } else if (job->spillPath.length() > 0) {
+            printSpilledBody(job->spillPath, CURL_DISPLAY_LIMIT);
+        } else {
+            PrintSinkState state;
+            state.length = 0;
+            printSink((const uint8_t*)job->body, job->bytes, &state);
+            printSinkFlush(state);
+        }
+
+        if (job->truncated && opts.outFile.length() == 0 && !isBinaryContent(contentType)) {
+            printLine("");
+            if (job->length > 0) {
+                printLine("... (+" + String(job->length - (int)job->bytes) + " bytes)");
+            }
+            printLine("Response truncated at " + String(CURL_DISPLAY_LIMIT) + " bytes");
+        }
+
+        if (job->error.length() > 0) {
+            printLine("curl: " + job->error);
+        }
+    }
+
+    xSemaphoreTake(jobMutex, portMAX_DELAY);
+    if (opts.outFile.length() == 0 && job->spillPath.length() > 0) {
+        vfs().remove(job->spillPath);
+        fsCacheRemove(job->spillPath);
+    }
+    job->opts = CurlOptions();
+    job->spillPath = "";
+    job->error = "";
+    job->state = JOB_FREE;
+    xSemaphoreGive(jobMutex);
+}
@@ -0,0 +1,389 @@
+#include "httppool.h"
+#include "httpstream.h"
+#include "display.h"
+#include "dnscache.h"
+#include "kernel.h"
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+
+// Keeps one HTTPClient and socket per recent origin so repeat requests skip
+// DNS, the TCP handshake and, for https, the TLS handshake. A connection is
+// only kept when the caller read its response to the end; otherwise stale
+// bytes would be taken for the next response. A periodic sweep marks idle
+// connections as expired and the "httpsweep" process closes them, since
+// closing a TLS connection blocks and must not stall the timer task.
+//
+// Pooled clients never follow redirects themselves: HTTPClient would move
+// the socket to the new origin behind the pool's back. httpRedirect() does
+// the hop instead, with a connection for the right origin.
+
+struct PoolEntry {
+    char host[64];
+    uint16_t port;
+    bool secure;
+    WiFiClient* client;
+    HTTPClient* http;
+    bool inUse;
+    bool reused;
+    bool expired;              // idle too long, waiting for httpsweep
+    uint32_t lastUsed;
+    uint32_t requests;
+};
+
+static PoolEntry pool[HTTP_POOL_SIZE];
+static SemaphoreHandle_t poolMutex = NULL;
+static TimerHandle_t sweepTimer = NULL;
+static TaskHandle_t sweepTask = NULL;
+static HttpPoolStats stats;
+
+static bool parseOrigin(const String& url, char* host, size_t hostSize,
+                        uint16_t& port, bool& secure) {
+    int start;
+    if (url.startsWith("https://")) {
+        secure = true;
+        port = 443;
+        start = 8;
+    } else if (url.startsWith("http://")) {
+        secure = false;
+        port = 80;
+        start = 7;
+    } else {
+        return false;
+    }
+
+    int end = start;
+    while (end < (int)url.length() && url[end] != '/' && url[end] != '?') end++;
+
+    String authority = url.substring(start, end);
+    int at = authority.lastIndexOf('@');
+    if (at >= 0) authority = authority.substring(at + 1);
+
+    int colon = authority.lastIndexOf(':');
+    if (colon >= 0) {
+        port = authority.substring(colon + 1).toInt();
+        authority = authority.substring(0, colon);
+    }
+    if (authority.length() == 0 || authority.length() >= hostSize) return false;
+
+    authority.toLowerCase();
+    strcpy(host, authority.c_str());
+    return true;
+}
+
+static void closeEntry(PoolEntry& e) {
+    if (e.client) e.client->stop();
+    e.host[0] = '\0';
+    e.requests = 0;
+    e.expired = false;
+}
+
+static void destroyEntry(PoolEntry& e) {
+    closeEntry(e);
+    delete e.http;
+    delete e.client;
+    e.http = NULL;
+    e.client = NULL;
+}
+
+// Runs in the timer task: only marks, never closes.
+static void sweepCallback(TimerHandle_t timer) {
+    if (xSemaphoreTake(poolMutex, 0) != pdTRUE) return;
+
+    uint32_t now = millis();
+    bool found = false;
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        PoolEntry& e = pool[i];
+        if (e.inUse || e.host[0] == '\0') continue;
+        if (now - e.lastUsed > HTTP_POOL_IDLE_MS) {
+            e.expired = true;
+            found = true;
+        }
+    }
+
+    xSemaphoreGive(poolMutex);
+    if (found && sweepTask) xTaskNotifyGive(sweepTask);
+}
+
+static void sweepProcess(void* parameter) {
+    sweepTask = xTaskGetCurrentTaskHandle();
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(poolMutex, portMAX_DELAY);
+        for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+            PoolEntry& e = pool[i];
+            if (e.expired && !e.inUse) {
+                closeEntry(e);
+                stats.evicted++;
+            }
+        }
+        xSemaphoreGive(poolMutex);
+    }
+}
+
+void httpPoolInit() {
+    poolMutex = xSemaphoreCreateMutex();
+    memset(pool, 0, sizeof(pool));
+    memset(&stats, 0, sizeof(stats));
+
+    createProcess(sweepProcess, "httpsweep", HTTP_SWEEP_STACK, 1);
+
+    sweepTimer = xTimerCreate("httppool", pdMS_TO_TICKS(HTTP_POOL_SWEEP_MS), pdTRUE,
+                              NULL, sweepCallback);
+    if (sweepTimer) xTimerStart(sweepTimer, 0);
+}
+
+// Opens the socket ourselves with an address from the DNS cache; HTTPClient
+// sees it connected and skips its own lookup. If this fails HTTPClient
+// still tries by name and reports the error.
+static void preconnect(PoolEntry& e, const IPAddress& ip) {
+    if (e.secure) {
+        ((WiFiClientSecure*)e.client)->connect(ip, e.port, e.host, NULL, NULL, NULL);
+    } else {
+        e.client->connect(ip, e.port);
+    }
+}
+
+// Returns a client that has begin() called for url, reusing an idle
+// connection to the same origin when one is open. NULL if the URL is not
+// http(s), the host does not resolve or every entry is busy.
+HTTPClient* httpAcquire(const String& url) {
+    char host[64];
+    uint16_t port;
+    bool secure;
+    if (!parseOrigin(url, host, sizeof(host), port, secure)) return NULL;
+
+    IPAddress ip;
+    bool resolved = false;
+    xSemaphoreTake(poolMutex, portMAX_DELAY);
+
+    PoolEntry* pick = NULL;
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        PoolEntry& e = pool[i];
+        if (!e.inUse && !e.expired && e.host[0] && e.port == port && e.secure == secure &&
+            strcmp(e.host, host) == 0) {
+            pick = &e;
+            break;
+        }
+    }
+    if (pick == NULL) {
+        xSemaphoreGive(poolMutex);
+        if (!dnsResolve(host, ip)) return NULL;
+        resolved = true;
+        xSemaphoreTake(poolMutex, portMAX_DELAY);
+
+        for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+            PoolEntry& e = pool[i];
+            if (e.inUse) continue;
+            if (pick == NULL || e.host[0] == '\0' ||
+                (pick->host[0] && e.lastUsed < pick->lastUsed)) {
+                pick = &e;
+            }
+            if (e.host[0] == '\0') break;
+        }
+        if (pick) {
+            if (pick->client && pick->secure != secure) {
+                destroyEntry(*pick);
+            } else {
+                closeEntry(*pick);
+            }
+        }
+    }
+
+    if (pick == NULL) {
+        xSemaphoreGive(poolMutex);
+        return NULL;
+    }
+
+    if (pick->client == NULL) {
+        if (secure) {
+            WiFiClientSecure* tls = new WiFiClientSecure;
+            tls->setInsecure();
+            pick->client = tls;
+        } else {
+            pick->client = new WiFiClient;
+        }
+        pick->http = new HTTPClient;
+    }
+    strcpy(pick->host, host);
+    pick->port = port;
+    pick->secure = secure;
+    pick->inUse = true;
+    pick->expired = false;
+    pick->reused = pick->client->connected();
+
+    stats.requests++;
+    if (pick->reused) stats.reused++;
+    else stats.opened++;
+
+    xSemaphoreGive(poolMutex);
+
+    if (!pick->reused && (resolved || dnsResolve(host, ip))) preconnect(*pick, ip);
+
+    HTTPClient* http = pick->http;
+    http->setReuse(true);
+    http->setTimeout(HTTP_STREAM_IDLE_MS);
+    http->setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+    http->setUserAgent("MiniOS/1.0");
+    http->collectHeaders(httpStreamHeaders, httpStreamHeaderCount);
+    if (!http->begin(*pick->client, url)) {
+        httpRelease(http, false);
+        return NULL;
+    }
+    return http;
+}
+
+bool httpWasReused(HTTPClient* http) {
+    bool reused = false;
+    xSemaphoreTake(poolMutex, portMAX_DELAY);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (pool[i].http == http) {
+            reused = pool[i].reused;
+            break;
+        }
+    }
+    xSemaphoreGive(poolMutex);
+    return reused;
+}
+
+// reusable: the whole response body was consumed, so the connection can
+// carry the next request.
+void httpRelease(HTTPClient* http, bool reusable) {
+    if (http == NULL) return;
+
+    xSemaphoreTake(poolMutex, portMAX_DELAY);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        PoolEntry& e = pool[i];
+        if (e.http != http) continue;
+
+        if (!reusable) http->setReuse(false);
+        http->end();
+        if (!reusable || !e.client->connected()) {
+            closeEntry(e);
+        } else {
+            e.requests++;
+        }
+        e.lastUsed = millis();
+        e.inUse = false;
+        break;
+    }
+    xSemaphoreGive(poolMutex);
+}
+
+static bool discardSink(const uint8_t* data, size_t len, void* ctx) {
+    return true;
+}
+
+// If code is a redirect with a Location, drains and releases http, then
+// acquires a client for the target and points url at it. The caller sets
+// up and sends the request again.
+bool httpRedirect(HTTPClient*& http, int code, String& url) {
+    if (code != 301 && code != 302 && code != 303 && code != 307 && code != 308) {
+        return false;
+    }
+    String location = http->header("Location");
+    if (location.length() == 0) return false;
+
+    if (location.startsWith("/")) {
+        int slash = url.indexOf('/', url.indexOf("//") + 2);
+        location = (slash > 0 ? url.substring(0, slash) : url) + location;
+    } else if (!location.startsWith("http://") && !location.startsWith("https://")) {
+        return false;
+    }
+
+    HttpStreamResult result;
+    httpStreamBody(*http, discardSink, NULL, 0, result);
+    httpRelease(http, result.complete);
+
+    url = location;
+    http = httpAcquire(url);
+    return http != NULL;
+}
+
+void httpPoolStats(HttpPoolStats& out) {
+    xSemaphoreTake(poolMutex, portMAX_DELAY);
+    out = stats;
+    xSemaphoreGive(poolMutex);
+}
+
+void httpPoolShow() {
+    char line[80];
+    uint32_t now = millis();
+
+    xSemaphoreTake(poolMutex, portMAX_DELAY);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        PoolEntry& e = pool[i];
+        if (e.host[0] == '\0') continue;
+        snprintf(line, sizeof(line), "  %-5s %.24s:%u %s, %lu req, %lus idle",
+                 e.secure ? "https" : "http", e.host, e.port,
+                 e.inUse ? "busy" : "idle", (unsigned long)e.requests,
+                 (unsigned long)((now - e.lastUsed) / 1000));
+        printLine(line);
+    }
+    snprintf(line, sizeof(line), "Requests: %lu  Opened: %lu  Reused: %lu  Evicted: %lu",
+             (unsigned long)stats.requests, (unsigned long)stats.opened,
+             (unsigned long)stats.reused, (unsigned long)stats.evicted);
+    xSemaphoreGive(poolMutex);
+    printLine(line);
+}
+
+// count sequential GETs, either keeping the connection between them or
+// closing it after each one so every request pays for a fresh handshake.
+static bool benchRun(const String& url, int count, bool keepAlive,
+                     uint32_t& total, uint32_t& minMs, uint32_t& maxMs, int& failed) {
+    total = 0;
+    minMs = UINT32_MAX;
+    maxMs = 0;
+    failed = 0;
+
+    for (int i = 0; i < count; i++) {
+        uint32_t start = millis();
+
+        HTTPClient* http = httpAcquire(url);
+        if (http == NULL) return false;
+
+        int code = http->GET();
+        HttpStreamResult result;
+        result.complete = false;
+        if (code > 0) {
+            httpStreamBody(*http, discardSink, NULL, 0, result);
+        } else {
+            failed++;
+        }
+        httpRelease(http, keepAlive && result.complete);
+
+        uint32_t elapsed = millis() - start;
+        total += elapsed;
+        if (elapsed < minMs) minMs = elapsed;
+        if (elapsed > maxMs) maxMs = elapsed;
+    }
+    return true;
+}
+
+void httpBench(String url, int count) {
+    if (WiFi.status() != WL_CONNECTED) {
+        printLine("httpbench: not connected to WiFi");
+        return;
+    }
+    if (count <= 0) count = HTTP_BENCH_DEFAULT;
+
+    const char* labels[2] = {"keep-alive", "new conn  "};
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t total, minMs, maxMs;
+        int failed;
+        if (!benchRun(url, count, pass == 0, total, minMs, maxMs, failed)) {
+            printLine("httpbench: cannot connect to " + url);
+            return;
+        }
+
+        char line[80];
+        sprintf(line, "%s x%d: avg %lu ms, min %lu, max %lu, fail %d",
+                labels[pass], count, (unsigned long)(total / count),
+                (unsigned long)minMs, (unsigned long)maxMs, failed);
+        printLine(line);
+    }
+    httpPoolShow();
+}
@@ -0,0 +1,196 @@
+#include "httpstream.h"
+#include "display.h"
+#include <FS.h>
+
+// Reads an HTTP body from the client's socket through one fixed buffer and
+// hands it to a sink as it arrives, so nothing is held in memory beyond
+// HTTP_STREAM_BUF. Chunked transfer encoding is decoded here because
+// getStreamPtr() exposes the raw connection.
+
+const char* httpStreamHeaders[] = {
+    "Content-Type", "Content-Length", "Transfer-Encoding",
+    "Server", "Location", "Content-Range", "Connection"
+};
+const size_t httpStreamHeaderCount = sizeof(httpStreamHeaders) / sizeof(httpStreamHeaders[0]);
+
+struct StreamState {
+    WiFiClient* stream;
+    uint8_t buf[HTTP_STREAM_BUF];
+    HttpSink sink;
+    void* ctx;
+    size_t limit;
+    uint32_t startHeap;
+    uint32_t lastData;
+    bool closed;
+    bool refused;               // the sink returned false
+    HttpStreamResult* result;
+};
+
+static void sampleHeap(StreamState& s) {
+    uint32_t free = ESP.getFreeHeap();
+    if (free < s.startHeap && s.startHeap - free > s.result->peakHeap) {
+        s.result->peakHeap = s.startHeap - free;
+    }
+}
+
+// Waits for data; false once the peer closed with nothing left or the
+// connection sat idle too long.
+static bool waitData(StreamState& s) {
+    while (s.stream->available() == 0) {
+        if (!s.stream->connected()) {
+            s.closed = true;
+            return false;
+        }
+        if (millis() - s.lastData > HTTP_STREAM_IDLE_MS) {
+            s.result->timedOut = true;
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    s.lastData = millis();
+    return true;
+}
+
+// Reads up to want bytes and passes them on. Returns false when reading
+// must stop: limit reached, sink refused, or the connection ended.
+static bool pump(StreamState& s, size_t want, size_t& got) {
+    got = 0;
+    if (!waitData(s)) return false;
+
+    size_t n = s.stream->available();
+    if (n > want) n = want;
+    if (n > sizeof(s.buf)) n = sizeof(s.buf);
+    if (s.limit && s.result->bytes + n > s.limit) n = s.limit - s.result->bytes;
+
+    n = s.stream->read(s.buf, n);
+    if (n == 0) return true;
+    got = n;
+    sampleHeap(s);
+
+    s.result->bytes += n;
+    if (!s.sink(s.buf, n, s.ctx)) {
+        s.refused = true;
+        return false;
+    }
+    return !(s.limit && s.result->bytes >= s.limit);
+}
+
+static bool readLine(StreamState& s, char* line, size_t size) {
+    size_t len = 0;
+    while (true) {
+        if (!waitData(s)) return false;
+        int c = s.stream->read();
+        if (c < 0) continue;
+        if (c == '\n') break;
+        if (c != '\r' && len < size - 1) line[len++] = c;
+    }
+    line[len] = '\0';
+    return true;
+}
+
+// A chunk-size line is hex digits, optionally followed by whitespace or
+// ";extensions". Anything else means the stream is out of step.
+static bool parseChunkSize(const char* line, size_t& size) {
+    char* end;
+    size = strtoul(line, &end, 16);
+    if (end == line || !isxdigit((unsigned char)line[0])) return false;
+    return *end == '\0' || *end == ';' || *end == ' ' || *end == '\t';
+}
+
+static bool readChunked(StreamState& s) {
+    char line[32];
+
+    while (true) {
+        if (!readLine(s, line, sizeof(line))) return false;
+        size_t remaining;
+        if (!parseChunkSize(line, remaining)) return false;
+
+        if (remaining == 0) {
+            // Trailers, then the blank line that ends the body
+            while (readLine(s, line, sizeof(line)) && line[0] != '\0') {}
+            return true;
+        }
+
+        while (remaining > 0) {
+            size_t got;
+            bool more = pump(s, remaining, got);
+            remaining -= got;
+            if (!more) return false;
+        }
+        if (!readLine(s, line, sizeof(line))) return false;
+    }
+}
+
+static bool readIdentity(StreamState& s, int length) {
+    size_t remaining = length < 0 ? SIZE_MAX : (size_t)length;
+
+    while (remaining > 0) {
+        size_t got;
+        bool more = pump(s, remaining, got);
+        remaining -= got;
+        // Without a length the body ends when the server closes. Reaching
+        // the limit on the body's last byte still read all of it.
+        if (!more) return !s.refused && (remaining == 0 || (length < 0 && s.closed));
+    }
+    return true;
+}
+
+// limit caps the bytes handed to the sink (0 for none). Stopping early
+// leaves unread data on the socket, so the caller must end() the client
+// rather than reuse it.
+bool httpStreamBody(HTTPClient& http, HttpSink sink, void* ctx, size_t limit,
+                    HttpStreamResult& result) {
+    memset(&result, 0, sizeof(result));
+
+    StreamState s;
+    s.stream = http.getStreamPtr();
+    s.sink = sink;
+    s.ctx = ctx;
+    s.limit = limit;
+    s.startHeap = ESP.getFreeHeap();
+    s.lastData = millis();
+    s.closed = false;
+    s.refused = false;
+    s.result = &result;
+
+    uint32_t start = millis();
+    if (s.stream) {
+        String encoding = http.header("Transfer-Encoding");
+        encoding.toLowerCase();
+        result.chunked = encoding.indexOf("chunked") >= 0;
+
+        result.complete = result.chunked ? readChunked(s) : readIdentity(s, http.getSize());
+    }
+    result.elapsedMs = millis() - start;
+    return result.complete;
+}
+
+bool printSink(const uint8_t* data, size_t len, void* ctx) {
+    PrintSinkState* state = (PrintSinkState*)ctx;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\r') continue;
+        if (c == '\n' || state->length == sizeof(state->line) - 1) {
+            state->line[state->length] = '\0';
+            printLine(state->line);
+            state->length = 0;
+            if (c == '\n') continue;
+        }
+        state->line[state->length++] = c;
+    }
+    return true;
+}
+
+void printSinkFlush(PrintSinkState& state) {
+    if (state.length > 0) {
+        state.line[state.length] = '\0';
+        printLine(state.line);
+        state.length = 0;
+    }
+}
+
+bool fileSink(const uint8_t* data, size_t len, void* ctx) {
+    fs::File* file = (fs::File*)ctx;
+    return file->write(data, len) == len;
+}
@@ -1,46 +1,268 @@
 #include "kernel.h"
 #include "display.h"  
+#include "console.h"
+#include "theme.h"
+#include "tty.h"
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/event_groups.h>
 #include <esp_system.h>
+#include <freertos/timers.h>
 
+// Slot-indexed process table. A PID encodes its slot and the slot's
+// generation, so lookups are a single index plus a PID compare and a stale
+// PID never matches a reused slot. Writers serialise on kernelMutex and bump
+// tableSeq around every change; readers copy entries under the seqlock and
+// never block create/kill.
 static Process processTable[MAX_PROCESSES];
+static uint16_t slotGeneration[MAX_PROCESSES];
 static int processCount = 0;
-static int nextPID = 1;
+static int nextSlot = 0;
+static volatile uint32_t tableSeq = 0;
 static uint32_t bootTime = 0;
 static SemaphoreHandle_t kernelMutex = NULL;
+static EventGroupHandle_t exitEvents = NULL;
+
+// Snapshot of every FreeRTOS task, refreshed only when someone asks for
+// process state; guarded by snapshotMutex.
+static SemaphoreHandle_t snapshotMutex = NULL;
+static TaskStatus_t* taskSnapshot = NULL;
+static int taskSnapshotCap = 0;
+static int taskSnapshotCount = 0;
+static uint32_t snapshotRunTime = 0;
+static uint32_t lastPsRunTime = 0;
+static uint32_t psLastRunTime[MAX_PROCESSES];
+
+// Idle-task run time per core, sampled once per CPU_SAMPLE_MS by a software
+// timer. Utilisation is derived from the oldest and newest sample, giving a
+// sliding window of CPU_WINDOW_SAMPLES periods.
+struct CpuSample {
+    uint32_t total;
+    uint32_t idle[portNUM_PROCESSORS];
+};
+
+static CpuSample cpuSamples[CPU_WINDOW_SAMPLES + 1];
+static int cpuSampleHead = 0;
+static int cpuSampleCount = 0;
+static portMUX_TYPE cpuSampleMux = portMUX_INITIALIZER_UNLOCKED;
+static TimerHandle_t cpuSampleTimer = NULL;
+static TaskStatus_t* samplerSnapshot = NULL;
+static int samplerSnapshotCap = 0;
+
+#define PID_SLOT(pid) ((pid) % MAX_PROCESSES)
+#define SLOT_BIT(slot) ((EventBits_t)1 << (slot))
+
+static void beginTableWrite() {
+    tableSeq++;
+    __sync_synchronize();
+}
+
+static void endTableWrite() {
+    __sync_synchronize();
+    tableSeq++;
+}
+
+static uint32_t readTableSeq() {
+    while (true) {
+        uint32_t seq = tableSeq;
+        __sync_synchronize();
+        if ((seq & 1) == 0) return seq;
+        vTaskDelay(1);
+    }
+}
+
+static bool tableChanged(uint32_t seq) {
+    __sync_synchronize();
+    return tableSeq != seq;
+}
+
+static bool readProcess(int pid, Process& out) {
+    if (pid <= 0) return false;
+    
+    uint32_t seq;
+    do {
+        seq = readTableSeq();
+        out = processTable[PID_SLOT(pid)];
+    } while (tableChanged(seq));
+    
+    return out.pid == pid;
+}
+
+static int copyProcessTable(Process* out) {
+    uint32_t seq;
+    int count;
+    do {
+        seq = readTableSeq();
+        memcpy(out, processTable, sizeof(processTable));
+        count = processCount;
+    } while (tableChanged(seq));
+    return count;
+}
+
+// uxTaskGetSystemState() returns 0 when the buffer is smaller than the
+// number of tasks, so the buffer grows with the task count, with
+// TASK_SNAPSHOT_SLACK spare for tasks created in between.
+static int snapshotTasks(TaskStatus_t*& buf, int& cap, uint32_t* runTime) {
+    int wanted = uxTaskGetNumberOfTasks() + TASK_SNAPSHOT_SLACK;
+    if (wanted > cap) {
+        TaskStatus_t* bigger = (TaskStatus_t*)realloc(buf, wanted * sizeof(TaskStatus_t));
+        if (bigger) {
+            buf = bigger;
+            cap = wanted;
+        }
+    }
+    return buf ? uxTaskGetSystemState(buf, cap, runTime) : 0;
+}
+
+// False when no snapshot could be taken; a task missing from a failed
+// snapshot must not be taken as gone.
+static bool takeTaskSnapshot() {
+    taskSnapshotCount = snapshotTasks(taskSnapshot, taskSnapshotCap, &snapshotRunTime);
+    return taskSnapshotCount > 0;
+}
+
+static TaskStatus_t* findTask(TaskHandle_t handle) {
+    for (int i = 0; i < taskSnapshotCount; i++) {
+        if (taskSnapshot[i].xHandle == handle) {
+            return &taskSnapshot[i];
+        }
+    }
+    return NULL;
+}
+
+static ProcessState stateFromTask(const TaskStatus_t* task) {
+    if (!task) return PROC_TERMINATED;
+    
+    switch (task->eCurrentState) {
+        case eRunning: return PROC_RUNNING;
+        case eReady: return PROC_READY;
+        case eBlocked: return PROC_BLOCKED;
+        case eSuspended: return PROC_SLEEPING;
+        default: return PROC_TERMINATED;
+    }
+}
+
+static const char* stateName(ProcessState state) {
+    switch (state) {
+        case PROC_RUNNING: return "RUN";
+        case PROC_READY: return "RDY";
+        case PROC_BLOCKED: return "BLK";
+        case PROC_SLEEPING: return "SLP";
+        case PROC_TERMINATED: return "END";
+        default: return "???";
+    }
+}
+
+// Caller holds kernelMutex.
+static void releaseSlot(int slot) {
+    beginTableWrite();
+    processTable[slot].pid = 0;
+    processTable[slot].handle = NULL;
+    processCount--;
+    endTableWrite();
+    
+    xEventGroupSetBits(exitEvents, SLOT_BIT(slot));
+}
+
+// Drops entries whose task has already deleted itself without calling
+// exitProcess(). Caller holds kernelMutex and snapshotMutex and has just
+// refreshed the snapshot.
+static void reapProcesses() {
+    for (int slot = 0; slot < MAX_PROCESSES; slot++) {
+        if (processTable[slot].pid != 0 && !findTask(processTable[slot].handle)) {
+            releaseSlot(slot);
+        }
+    }
+}
+
+static void cpuSampleCallback(TimerHandle_t timer) {
+#if configGENERATE_RUN_TIME_STATS
+    CpuSample sample;
+    memset(&sample, 0, sizeof(sample));
+    
+    int count = snapshotTasks(samplerSnapshot, samplerSnapshotCap, &sample.total);
+    if (count == 0) return;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        TaskHandle_t idle = xTaskGetIdleTaskHandleForCPU(core);
+        for (int i = 0; i < count; i++) {
+            if (samplerSnapshot[i].xHandle == idle) {
+                sample.idle[core] = samplerSnapshot[i].ulRunTimeCounter;
+                break;
+            }
+        }
+    }
+    
+    taskENTER_CRITICAL(&cpuSampleMux);
+    cpuSamples[cpuSampleHead] = sample;
+    cpuSampleHead = (cpuSampleHead + 1) % (CPU_WINDOW_SAMPLES + 1);
+    if (cpuSampleCount < CPU_WINDOW_SAMPLES + 1) cpuSampleCount++;
+    taskEXIT_CRITICAL(&cpuSampleMux);
+#endif
+}
 
 void kernelInit() {
     bootTime = millis();
     kernelMutex = xSemaphoreCreateMutex();
+    snapshotMutex = xSemaphoreCreateMutex();
+    exitEvents = xEventGroupCreate();
     
-    if (!kernelMutex) {
+    if (!kernelMutex || !snapshotMutex || !exitEvents) {
         Serial.println("ERROR: Failed to create kernel mutex");
         return;
     }
     
     memset(processTable, 0, sizeof(processTable));
+    memset(slotGeneration, 0, sizeof(slotGeneration));
     processCount = 0;
     
+#if configGENERATE_RUN_TIME_STATS
+    cpuSampleTimer = xTimerCreate("cpustat", pdMS_TO_TICKS(CPU_SAMPLE_MS), pdTRUE,
+                                  NULL, cpuSampleCallback);
+    if (cpuSampleTimer) {
+        cpuSampleCallback(cpuSampleTimer);
+        xTimerStart(cpuSampleTimer, 0);
+    }
+#endif
+    
     Serial.println("[KERNEL] Kernel initialized");
 }
 
+static int findFreeSlot() {
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        int slot = (nextSlot + i) % MAX_PROCESSES;
+        if (processTable[slot].pid == 0) {
+            nextSlot = (slot + 1) % MAX_PROCESSES;
+            return slot;
+        }
+    }
+    return -1;
+}
+
 int createProcess(TaskFunction_t function, const char* name, uint32_t stackSize, 
-                  UBaseType_t priority) {
-    if (processCount >= MAX_PROCESSES) {
+                  UBaseType_t priority, void* param) {
+    xSemaphoreTake(kernelMutex, portMAX_DELAY);
+    
+    int slot = findFreeSlot();
+    if (slot < 0) {
+        xSemaphoreTake(snapshotMutex, portMAX_DELAY);
+        if (takeTaskSnapshot()) reapProcesses();
+        xSemaphoreGive(snapshotMutex);
+        slot = findFreeSlot();
+    }
+    
+    if (slot < 0) {
+        xSemaphoreGive(kernelMutex);
         Serial.println("[KERNEL] ERROR: Process table full");
         return -1;
     }
     
-    xSemaphoreTake(kernelMutex, portMAX_DELAY);
-    
     TaskHandle_t handle = NULL;
     BaseType_t result = xTaskCreate(
         function,
         name,
         stackSize,
-        NULL,
+        param,
         priority,
         &handle
     );
@@ -51,17 +273,23 @@ int createProcess(TaskFunction_t function, const char* name, uint32_t stackSize,
         return -1;
     }
     
-    Process *proc = &processTable[processCount];
+    if (++slotGeneration[slot] == 0) slotGeneration[slot] = 1;
+    int pid = slotGeneration[slot] * MAX_PROCESSES + slot;
+    
+    xEventGroupClearBits(exitEvents, SLOT_BIT(slot));
+    
+    beginTableWrite();
+    Process *proc = &processTable[slot];
     proc->handle = handle;
     proc->name = name;
-    proc->state = PROC_READY;
     proc->priority = priority;
     proc->createdAt = millis();
     proc->stackSize = stackSize;
-    proc->pid = nextPID++;
-    
-    int pid = proc->pid;
+    proc->pid = pid;
     processCount++;
+    endTableWrite();
+    
+    psLastRunTime[slot] = 0;
     
     xSemaphoreGive(kernelMutex);
     
@@ -74,110 +302,150 @@ int createProcess(TaskFunction_t function, const char* name, uint32_t stackSize,
 int killProcess(int pid) {
     xSemaphoreTake(kernelMutex, portMAX_DELAY);
     
-    for (int i = 0; i < processCount; i++) {
-        if (processTable[i].pid == pid) {
-            TaskHandle_t handle = processTable[i].handle;
-            const char* name = processTable[i].name;
-            
-            for (int j = i; j < processCount - 1; j++) {
-                processTable[j] = processTable[j + 1];
-            }
-            processCount--;
-            
-            xSemaphoreGive(kernelMutex);
-            
-            vTaskDelete(handle);
-            
-            char msg[80];
-            sprintf(msg, "Killed process '%s' (PID: %d)", name, pid);
-            printLine(msg);
-            
-            return 0;
-        }
+    Process proc;
+    if (!readProcess(pid, proc)) {
+        xSemaphoreGive(kernelMutex);
+        
+        char msg[80];
+        sprintf(msg, "ERROR: Process PID %d not found", pid);
+        printLine(msg);
+        return -1;
     }
     
+    xSemaphoreTake(snapshotMutex, portMAX_DELAY);
+    bool known = takeTaskSnapshot();
+    bool alive = findTask(proc.handle) != NULL;
+    xSemaphoreGive(snapshotMutex);
+    
+    if (!known) {
+        xSemaphoreGive(kernelMutex);
+        printLine("ERROR: Cannot read task list, nothing killed");
+        return -1;
+    }
+    
+    // The task is deleted while kernelMutex is held: one blocked in
+    // exitProcess() cannot then release its slot and delete itself too.
+    bool self = proc.handle == xTaskGetCurrentTaskHandle();
+    if (alive && !self) {
+        vTaskDelete(proc.handle);
+    }
+    releaseSlot(PID_SLOT(pid));
+    
     xSemaphoreGive(kernelMutex);
     
+    if (alive && self) {
+        vTaskDelete(NULL);
+    }
+    
     char msg[80];
-    sprintf(msg, "ERROR: Process PID %d not found", pid);
+    sprintf(msg, "Killed process '%s' (PID: %d)", proc.name, pid);
     printLine(msg);
     
-    return -1;
+    return 0;
 }
 
-void listProcesses() {
+void exitProcess() {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    
     xSemaphoreTake(kernelMutex, portMAX_DELAY);
+    for (int slot = 0; slot < MAX_PROCESSES; slot++) {
+        if (processTable[slot].pid != 0 && processTable[slot].handle == self) {
+            releaseSlot(slot);
+            break;
+        }
+    }
+    xSemaphoreGive(kernelMutex);
+    
+    vTaskDelete(NULL);
+}
+
+void listProcesses() {
+    Process table[MAX_PROCESSES];
+    int count = copyProcessTable(table);
     
-    if (processCount == 0) {
+    if (count == 0) {
         printLine("No processes running");
-        xSemaphoreGive(kernelMutex);
         return;
     }
     
+    xSemaphoreTake(snapshotMutex, portMAX_DELAY);
+    bool known = takeTaskSnapshot();
+    
     printLine("");
     printLine("PROCESS LIST");
     printLine("----------------------------------");
     
+    // CPU share is measured since the previous 'ps', across all cores.
+    uint32_t window = (snapshotRunTime - lastPsRunTime) * portNUM_PROCESSORS;
     uint32_t now = millis();
-    for (int i = 0; i < processCount; i++) {
-        Process *proc = &processTable[i];
+    bool needsReap = false;
+    
+    for (int slot = 0; slot < MAX_PROCESSES; slot++) {
+        Process *proc = &table[slot];
+        if (proc->pid == 0) continue;
         
-        const char* stateStr;
-        switch (proc->state) {
-            case PROC_RUNNING: stateStr = "RUN"; break;
-            case PROC_READY: stateStr = "RDY"; break;
-            case PROC_BLOCKED: stateStr = "BLK"; break;
-            case PROC_SLEEPING: stateStr = "SLP"; break;
-            case PROC_TERMINATED: stateStr = "END"; break;
-            default: stateStr = "???"; break;
-        }
+        TaskStatus_t *task = findTask(proc->handle);
+        if (!task && known) needsReap = true;
+        
+        const char* stateStr = stateName(stateFromTask(task));
         
         uint32_t uptime = now - proc->createdAt;
         uint32_t uptimeSec = uptime / 1000;
         
+        char cpu[8] = "  -";
+#if configGENERATE_RUN_TIME_STATS
+        if (task && window > 0) {
+            uint32_t used = task->ulRunTimeCounter - psLastRunTime[slot];
+            sprintf(cpu, "%3u", (unsigned)((uint64_t)used * 100 / window));
+            psLastRunTime[slot] = task->ulRunTimeCounter;
+        }
+#endif
+        
         char line[80];
-        sprintf(line, "%d: %-12s P:%d %s %lus",
+        sprintf(line, "%d: %-12s P:%d %s %s%% %lus",
                 proc->pid,
                 proc->name,
                 proc->priority,
                 stateStr,
+                cpu,
                 uptimeSec);
         printLine(line);
     }
     
     printLine("----------------------------------");
     
-    xSemaphoreGive(kernelMutex);
+    lastPsRunTime = snapshotRunTime;
+    xSemaphoreGive(snapshotMutex);
+    
+    if (needsReap) {
+        xSemaphoreTake(kernelMutex, portMAX_DELAY);
+        xSemaphoreTake(snapshotMutex, portMAX_DELAY);
+        if (takeTaskSnapshot()) reapProcesses();
+        xSemaphoreGive(snapshotMutex);
+        xSemaphoreGive(kernelMutex);
+    }
 }
 
 ProcessState getProcessState(int pid) {
-    xSemaphoreTake(kernelMutex, portMAX_DELAY);
-    
-    for (int i = 0; i < processCount; i++) {
-        if (processTable[i].pid == pid) {
-            ProcessState state = processTable[i].state;
-            xSemaphoreGive(kernelMutex);
-            return state;
-        }
+    Process proc;
+    if (!readProcess(pid, proc)) {
+        return PROC_TERMINATED;
     }
     
-    xSemaphoreGive(kernelMutex);
-    return PROC_TERMINATED;
+    xSemaphoreTake(snapshotMutex, portMAX_DELAY);
+    // Still in the table; without a snapshot its state is unknown.
+    ProcessState state = takeTaskSnapshot() ? stateFromTask(findTask(proc.handle)) : PROC_READY;
+    xSemaphoreGive(snapshotMutex);
+    
+    return state;
 }
 
 uint32_t getProcessUptime(int pid) {
-    xSemaphoreTake(kernelMutex, portMAX_DELAY);
-    
-    for (int i = 0; i < processCount; i++) {
-        if (processTable[i].pid == pid) {
-            uint32_t uptime = millis() - processTable[i].createdAt;
-            xSemaphoreGive(kernelMutex);
-            return uptime;
-        }
+    Process proc;
+    if (!readProcess(pid, proc)) {
+        return 0;
     }
-    
-    xSemaphoreGive(kernelMutex);
-    return 0;
+    return millis() - proc.createdAt;
 }
 
 uint32_t getSystemUptime() {
@@ -192,10 +460,33 @@ uint32_t getTotalMem() {
     return heap_caps_get_total_size(MALLOC_CAP_8BIT);
 }
 
+float getCoreUsage(int core) {
+    if (core < 0 || core >= portNUM_PROCESSORS) return -1;
+    
+    taskENTER_CRITICAL(&cpuSampleMux);
+    if (cpuSampleCount < 2) {
+        taskEXIT_CRITICAL(&cpuSampleMux);
+        return -1;
+    }
+    int newest = (cpuSampleHead + CPU_WINDOW_SAMPLES) % (CPU_WINDOW_SAMPLES + 1);
+    int oldest = (cpuSampleHead + CPU_WINDOW_SAMPLES + 1 - cpuSampleCount) % (CPU_WINDOW_SAMPLES + 1);
+    uint32_t total = cpuSamples[newest].total - cpuSamples[oldest].total;
+    uint32_t idle = cpuSamples[newest].idle[core] - cpuSamples[oldest].idle[core];
+    taskEXIT_CRITICAL(&cpuSampleMux);
+    
+    if (total == 0) return -1;
+    if (idle > total) idle = total;
+    return 100.0f * (1.0f - (float)idle / (float)total);
+}
+
 float getCPUUsage() {
-    uint32_t free = getFreeMem();
-    uint32_t total = getTotalMem();
-    return 100.0f * (1.0f - ((float)free / (float)total));
+    float sum = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        float usage = getCoreUsage(core);
+        if (usage < 0) return -1;
+        sum += usage;
+    }
+    return sum / portNUM_PROCESSORS;
 }
 
 void printSystemStats() {
@@ -225,8 +516,17 @@ void printSystemStats() {
     sprintf(line, "Total RAM: %lu bytes", totalMem);
     printLine(line);
     
-    sprintf(line, "CPU Usage: %.1f%%", cpuUsage);
-    printLine(line);
+    if (cpuUsage < 0) {
+        printLine("CPU Usage: n/a (run-time stats disabled)");
+    } else {
+        sprintf(line, "CPU Usage: %.1f%% (%ds window)", cpuUsage,
+                CPU_WINDOW_SAMPLES * CPU_SAMPLE_MS / 1000);
+        printLine(line);
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            sprintf(line, "  Core %d:  %.1f%%", core, getCoreUsage(core));
+            printLine(line);
+        }
+    }
     
     sprintf(line, "Processes: %d/%d", processCount, MAX_PROCESSES);
     printLine(line);
@@ -240,42 +540,132 @@ void signalProcess(int pid, int signal) {
     printLine(msg);
 }
 
+// Blocks on the slot's exit bit instead of polling. The periodic recheck
+// covers tasks that delete themselves without calling exitProcess().
 void waitForProcess(int pid) {
     while (getProcessState(pid) != PROC_TERMINATED) {
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        xEventGroupWaitBits(exitEvents, SLOT_BIT(PID_SLOT(pid)), pdFALSE, pdTRUE,
+                            pdMS_TO_TICKS(WAIT_RECHECK_MS));
     }
 }
 
-void kernelScheduler(void *parameter) {
-    while (1) {
-        xSemaphoreTake(kernelMutex, portMAX_DELAY);
+static void topLine(int row, const char* text) {
+    char padded[TOP_COLS + 1];
+    snprintf(padded, sizeof(padded), "%-*s", TOP_COLS, text);
+    
+    tft.setCursor(5, row * 8);
+    tft.print(padded);
+    
+    Serial.print(text);
+    Serial.print("\033[K\r\n");
+}
+
+// Live process view: redraws fixed rows in place once per second until
+// ENTER is pressed. Per-process CPU is the share of both cores used since
+// the previous refresh.
+void topCommand() {
+    screenLocked = true;
+    tft.fillScreen(getCurrentTheme().bg);
+    Serial.print("\033[2J");
+    
+    TaskHandle_t prevHandle[MAX_PROCESSES];
+    uint32_t prevRunTime[MAX_PROCESSES];
+    int prevCount = 0;
+    uint32_t prevTotal = 0;
+    int lastRows = 0;
+    
+    while (true) {
+        char line[80];
+        int row = 0;
+        
+        Serial.print("\033[H");
+        
+        float cpu = getCPUUsage();
+        if (cpu < 0) {
+            topLine(row++, "CPU: n/a (run-time stats disabled)");
+        } else {
+            int len = sprintf(line, "CPU: %5.1f%% ", cpu);
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                len += sprintf(line + len, " C%d %5.1f%%", core, getCoreUsage(core));
+            }
+            topLine(row++, line);
+        }
+        
+        sprintf(line, "Mem: %lu/%lu bytes free  Up: %lus",
+                (unsigned long)getFreeMem(), (unsigned long)getTotalMem(),
+                (unsigned long)(getSystemUptime() / 1000));
+        topLine(row++, line);
+        topLine(row++, "");
+        topLine(row++, "PID NAME         PRI ST  CORE   CPU");
+        
+        Process table[MAX_PROCESSES];
+        copyProcessTable(table);
+        
+        xSemaphoreTake(snapshotMutex, portMAX_DELAY);
+        takeTaskSnapshot();
+        
+        uint32_t window = (snapshotRunTime - prevTotal) * portNUM_PROCESSORS;
+        TaskHandle_t curHandle[MAX_PROCESSES];
+        uint32_t curRunTime[MAX_PROCESSES];
+        int curCount = 0;
         
-        for (int i = 0; i < processCount; i++) {
-            eTaskState taskState = eTaskGetState(processTable[i].handle);
+        for (int slot = 0; slot < MAX_PROCESSES; slot++) {
+            Process *proc = &table[slot];
+            if (proc->pid == 0) continue;
             
-            switch (taskState) {
-                case eRunning:
-                    processTable[i].state = PROC_RUNNING;
-                    break;
-                case eReady:
-                    processTable[i].state = PROC_READY;
-                    break;
-                case eBlocked:
-                    processTable[i].state = PROC_BLOCKED;
-                    break;
-                case eSuspended:
-                    processTable[i].state = PROC_SLEEPING;
-                    break;
-                case eDeleted:
-                    processTable[i].state = PROC_TERMINATED;
-                    break;
-                default:
-                    break;
+            TaskStatus_t *task = findTask(proc->handle);
+            
+            char core[5] = " -";
+            char share[8] = "    -";
+            
+            if (task) {
+#if configTASKLIST_INCLUDE_COREID
+                if (task->xCoreID == tskNO_AFFINITY) {
+                    strcpy(core, " *");
+                } else {
+                    sprintf(core, "%2d", (int)task->xCoreID);
+                }
+#endif
+#if configGENERATE_RUN_TIME_STATS
+                curHandle[curCount] = proc->handle;
+                curRunTime[curCount] = task->ulRunTimeCounter;
+                curCount++;
+                
+                for (int j = 0; j < prevCount; j++) {
+                    if (prevHandle[j] == proc->handle && window > 0) {
+                        uint32_t used = task->ulRunTimeCounter - prevRunTime[j];
+                        sprintf(share, "%4.1f%%", (float)used * 100.0f / window);
+                        break;
+                    }
+                }
+#endif
             }
+            
+            sprintf(line, "%3d %-12s %3d %s %4s  %s",
+                    proc->pid, proc->name, (int)proc->priority,
+                    stateName(stateFromTask(task)), core, share);
+            topLine(row++, line);
         }
         
-        xSemaphoreGive(kernelMutex);
+        prevTotal = snapshotRunTime;
+        xSemaphoreGive(snapshotMutex);
+        
+        memcpy(prevHandle, curHandle, sizeof(TaskHandle_t) * curCount);
+        memcpy(prevRunTime, curRunTime, sizeof(uint32_t) * curCount);
+        prevCount = curCount;
         
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        topLine(row++, "");
+        topLine(row, "Press ENTER to exit");
+        for (int r = row + 1; r < lastRows; r++) {
+            topLine(r, "");
+        }
+        lastRows = row + 1;
+        
+        TtyLine input;
+        if (ttyReadLine(input, pdMS_TO_TICKS(TOP_REFRESH_MS))) {
+            screenLocked = false;
+            consoleRedraw();
+            return;
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,297 @@
+#include "logchan.h"
+#include "vfs.h"
+#include "fscache.h"
+#include "display.h"
+#include "kernel.h"
+#include <freertos/semphr.h>
+
+// Write-behind append channels for files that grow a line at a time.
+// appendFile() opens, writes and closes the file for every call, which on
+// flash means a metadata update per line. A channel instead collects lines
+// in a LOG_BUF_SIZE buffer and keeps its file handle open between writes.
+//
+// Buffered data is written to the open file when the buffer fills, when
+// its oldest byte is LOG_FLUSH_MS old, or on logSync(). The handle is
+// closed at least every LOG_COMMIT_MS and on logSync(); closing is what
+// makes the file's new size durable (LittleFS commits on close, SPIFFS
+// writes its index). The "logd" process does the timed work and sleeps
+// indefinitely while nothing is pending.
+//
+// After a power cut:
+//  - everything before the last commit (sync, close or LOG_COMMIT_MS) is
+//    on flash;
+//  - on LittleFS the file is exactly as it was at some commit, since
+//    LittleFS is copy-on-write; data written but not yet committed is lost;
+//  - on SPIFFS, part of what was written since the last commit may
+//    survive; what came before it is not touched;
+//  - at most LOG_BUF_SIZE bytes no older than LOG_FLUSH_MS never left RAM.
+// Call logSync() after a line that must not be lost. ls shows a channel's
+// file size as of its last commit.
+
+struct LogChannel {
+    bool inUse;
+    int users;                  // logOpen() calls not yet closed
+    char path[FS_PATH_MAX];
+    File file;
+    uint32_t openedAt;
+    uint32_t pendingSince;
+    size_t used;
+    uint32_t writes;
+    uint32_t bytes;
+    uint32_t flushes;
+    uint32_t commits;
+    uint8_t buf[LOG_BUF_SIZE];
+};
+
+static LogChannel* channels = NULL;
+static SemaphoreHandle_t logMutex = NULL;
+static TaskHandle_t logdTask = NULL;
+
+static void lockLog() {
+    xSemaphoreTake(logMutex, portMAX_DELAY);
+}
+
+static void unlockLog() {
+    xSemaphoreGive(logMutex);
+}
+
+static bool validChannel(int channel) {
+    return channel >= 0 && channel < LOG_CHANNELS && channels[channel].inUse;
+}
+
+// Caller holds logMutex.
+static bool openFile(LogChannel& c) {
+    if (c.file) return true;
+    c.file = vfs().open(c.path, FILE_APPEND);
+    if (!c.file) return false;
+    c.openedAt = millis();
+    return true;
+}
+
+// Caller holds logMutex.
+static bool flushChannel(LogChannel& c) {
+    if (c.used == 0) return true;
+    if (!openFile(c)) return false;
+
+    bool ok = c.file.write(c.buf, c.used) == c.used;
+    c.file.flush();
+    c.used = 0;
+    c.flushes++;
+    return ok;
+}
+
+// Caller holds logMutex.
+static bool commitChannel(LogChannel& c) {
+    bool ok = flushChannel(c);
+    if (c.file) {
+        c.file.close();
+        c.commits++;
+        fsCacheUpdate(c.path);
+    }
+    return ok;
+}
+
+static void logdProcess(void* parameter) {
+    logdTask = xTaskGetCurrentTaskHandle();
+
+    while (1) {
+        uint32_t wait = UINT32_MAX;
+
+        lockLog();
+        uint32_t now = millis();
+        for (int i = 0; i < LOG_CHANNELS; i++) {
+            LogChannel& c = channels[i];
+            if (!c.inUse) continue;
+
+            if (c.used > 0) {
+                uint32_t age = now - c.pendingSince;
+                if (age >= LOG_FLUSH_MS) flushChannel(c);
+                else if (LOG_FLUSH_MS - age < wait) wait = LOG_FLUSH_MS - age;
+            }
+            if (c.file) {
+                // The flush above may have just opened the file.
+                uint32_t age = millis() - c.openedAt;
+                if (age >= LOG_COMMIT_MS) commitChannel(c);
+                else if (LOG_COMMIT_MS - age < wait) wait = LOG_COMMIT_MS - age;
+            }
+        }
+        unlockLog();
+
+        ulTaskNotifyTake(pdTRUE, wait == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait));
+    }
+}
+
+void logInit() {
+    logMutex = xSemaphoreCreateMutex();
+    channels = new LogChannel[LOG_CHANNELS]();
+    createProcess(logdProcess, "logd", LOG_STACK, 1);
+}
+
+// Caller holds logMutex.
+static int findChannel(const String& full) {
+    for (int i = 0; i < LOG_CHANNELS; i++) {
+        if (channels[i].inUse && full == channels[i].path) return i;
+    }
+    return -1;
+}
+
+int logOpen(const char* path) {
+    if (channels == NULL) return -1;
+    String full = vfsPath(path);
+    if (full.length() >= FS_PATH_MAX) return -1;
+
+    lockLog();
+    int found = findChannel(full);
+    if (found >= 0) {
+        channels[found].users++;
+        unlockLog();
+        return found;
+    }
+
+    int free = -1;
+    for (int i = 0; i < LOG_CHANNELS && free < 0; i++) {
+        if (!channels[i].inUse) free = i;
+    }
+
+    if (free >= 0) {
+        LogChannel& c = channels[free];
+        c.inUse = true;
+        c.users = 1;
+        strlcpy(c.path, full.c_str(), sizeof(c.path));
+        c.used = 0;
+        c.writes = c.bytes = c.flushes = c.commits = 0;
+    }
+    unlockLog();
+    return free;
+}
+
+int logFind(const char* path) {
+    if (channels == NULL) return -1;
+    lockLog();
+    int found = findChannel(vfsPath(path));
+    unlockLog();
+    return found;
+}
+
+void logClose(int channel) {
+    if (channels == NULL) return;
+    lockLog();
+    if (validChannel(channel)) {
+        LogChannel& c = channels[channel];
+        commitChannel(c);
+        if (--c.users <= 0) c.inUse = false;
+    }
+    unlockLog();
+}
+
+// Caller holds logMutex. True in wasIdle when this starts a new flush
+// deadline, which can be sooner than the commit logd is sleeping towards.
+static bool writeChannel(LogChannel& c, const char* data, size_t length, bool& wasIdle) {
+    wasIdle = wasIdle || c.used == 0;
+    bool ok = true;
+
+    if (c.used + length > LOG_BUF_SIZE) ok = flushChannel(c);
+    if (length > LOG_BUF_SIZE) {
+        // Too big to batch: straight to the file.
+        ok = ok && openFile(c) && c.file.write((const uint8_t*)data, length) == length;
+    } else if (c.used + length > LOG_BUF_SIZE) {
+        // The file could not be opened and the buffer is full: drop it.
+        return false;
+    } else {
+        if (c.used == 0) c.pendingSince = millis();
+        memcpy(c.buf + c.used, data, length);
+        c.used += length;
+    }
+    c.bytes += length;
+    return ok;
+}
+
+static bool writeLocked(int channel, const char* data, size_t length, bool newline) {
+    if (channels == NULL) return false;
+    lockLog();
+    if (!validChannel(channel)) {
+        unlockLog();
+        return false;
+    }
+
+    LogChannel& c = channels[channel];
+    bool wasIdle = false;
+    bool ok = writeChannel(c, data, length, wasIdle);
+    if (newline) ok = writeChannel(c, "\n", 1, wasIdle) && ok;
+    c.writes++;
+    unlockLog();
+
+    if (wasIdle && logdTask) xTaskNotifyGive(logdTask);
+    return ok;
+}
+
+bool logWrite(int channel, const char* data, size_t length) {
+    return writeLocked(channel, data, length, false);
+}
+
+bool logLine(int channel, const char* text) {
+    return writeLocked(channel, text, strlen(text), true);
+}
+
+void logSync(int channel) {
+    if (channels == NULL) return;
+    lockLog();
+    for (int i = 0; i < LOG_CHANNELS; i++) {
+        if ((channel < 0 || channel == i) && channels[i].inUse) commitChannel(channels[i]);
+    }
+    unlockLog();
+}
+
+// Syncs every channel and holds them until logResume(): writers on other
+// tasks wait, so nothing reopens a file while the partition is unmounted.
+// The calling task must not log in between.
+void logSuspend() {
+    if (channels == NULL) return;
+    lockLog();
+    for (int i = 0; i < LOG_CHANNELS; i++) {
+        if (channels[i].inUse) commitChannel(channels[i]);
+    }
+}
+
+void logResume() {
+    if (channels == NULL) return;
+    unlockLog();
+}
+
+int logSyncPath(const String& path) {
+    if (channels == NULL) return -1;
+
+    lockLog();
+    int found = -1;
+    for (int i = 0; i < LOG_CHANNELS; i++) {
+        if (channels[i].inUse && path == channels[i].path) {
+            commitChannel(channels[i]);
+            found = i;
+        }
+    }
+    unlockLog();
+    return found;
+}
+
+void logShow() {
+    char line[96];
+    int shown = 0;
+    if (channels == NULL) {
+        printLine("No log channels open");
+        return;
+    }
+
+    lockLog();
+    for (int i = 0; i < LOG_CHANNELS; i++) {
+        LogChannel& c = channels[i];
+        if (!c.inUse) continue;
+        if (shown++ == 0) printLine("CH FILE                 BUF  WRITES  FLUSH COMMIT  OPEN");
+        snprintf(line, sizeof(line), "%-2d %-20s %4u %7lu %6lu %6lu  %s", i, c.path,
+                 (unsigned)c.used, (unsigned long)c.writes, (unsigned long)c.flushes,
+                 (unsigned long)c.commits, c.file ? "yes" : "no");
+        printLine(line);
+    }
+    unlockLog();
+
+    if (shown == 0) printLine("No log channels open");
+}
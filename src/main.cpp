@@ -8,10 +8,14 @@
 #include "pug.h"
 #include "timeutils.h"
 #include "kernel.h"
+#include "tty.h"
+#include "httppool.h"
+#include "dnscache.h"
+#include "timesync.h"
+#include "scheduler.h"
+#include "logchan.h"
 
-String input = "";
 bool screenLocked = false;
-bool inputLocked = false;
 
 void initProcess(void *parameter) {
     printLine("MiniOS - FreeRTOS Kernel");
@@ -21,56 +25,30 @@ void initProcess(void *parameter) {
     
     if (!initFilesystem()) {
         printLine("[ERROR] Filesystem failed");
-        vTaskDelete(NULL);
+        exitProcess();
         return;
     }
     
     printLine("[SYSTEM] Filesystem initialized");
     
+    schedulerLoad();
+    
     printLine("MiniOS Ready");
     printLine("Type 'help' for commands");
     printLine("");
     
     vTaskDelay(100 / portTICK_PERIOD_MS);
-    vTaskDelete(NULL);
+    exitProcess();
 }
 
 void serialInputProcess(void *parameter) {
-    const TickType_t delay = 10 / portTICK_PERIOD_MS;
-    
-    while (1) {
-        
-        if (!screenLocked && !inputLocked && Serial.available()) {
-            char c = Serial.read();
-
-            if (c == '\n') {
-                printLine("> " + input);
-                runCommand(input);
-                input = "";
-            } else if (c == '\b' || c == 127) {
-                if (input.length() > 0) {
-                    input.remove(input.length() - 1);
-                    Serial.write('\b');
-                    Serial.write(' ');
-                    Serial.write('\b');
-                }
-            } else {
-                input += c;
-                Serial.write(c);  
-            }
-        }
-        vTaskDelay(delay);
-    }
-}
-
-void alarmCheckProcess(void *parameter) {
-    const TickType_t delay = 1000 / portTICK_PERIOD_MS;
+    TtyLine line;
     
     while (1) {
-        if (!screenLocked) {
-            checkAlarm();
+        if (ttyReadLine(line, portMAX_DELAY)) {
+            printLine("> " + String(line.text));
+            runCommand(line.text);
         }
-        vTaskDelay(delay);
     }
 }
 
@@ -83,7 +61,7 @@ void watchdogProcess(void *parameter) {
 }
 
 void setup() {
-    Serial.begin(115200);
+    ttyInit(TTY_BAUD);
     delay(1000);
     
     Serial.println("MiniOS - FreeRTOS Kernel");
@@ -92,12 +70,17 @@ void setup() {
     initDisplay();
     
     kernelInit();
+    initCommands();
+    dnsCacheInit();
+    httpPoolInit();
+    timeSyncInit();
+    wifiInit();
+    logInit();
+    schedulerInit();
     
     createProcess(initProcess, "init", 4096, 1);
     createProcess(serialInputProcess, "shell", 16384, 2);
-    createProcess(alarmCheckProcess, "alarm", 1024, 1);
     createProcess(watchdogProcess, "watchdog", 1024, 0);
-    createProcess(kernelScheduler, "scheduler", 2048, KERNEL_PRIORITY);
 }
 
 void loop() {
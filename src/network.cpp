@@ -1,161 +1,324 @@
 #include "network.h"
+#include "vfs.h"
+#include "fscache.h"
 #include "display.h"
 #include "timeutils.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <ESP32Ping.h>
+#include "tty.h"
+#include "httpstream.h"
+#include "httppool.h"
+#include "dnscache.h"
+#include "kernel.h"
+#include "wifiprofiles.h"
+#include "timesync.h"
+#include <freertos/event_groups.h>
+#include <freertos/timers.h>
 
 String WIFI_SSID = "";
 String WIFI_PASS = "";
 NetworkStatus networkStatus = NET_DISCONNECTED;
-extern bool inputLocked;
 
-void connectWiFi() {
-    inputLocked = true;
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+static String promptLine(const char* prompt, TtyEcho echo) {
+    TtyLine line;
+    
+    ttyFlush();
+    ttySetEcho(echo);
+    printLine(prompt);
+    
+    String value = "";
+    while (value.length() == 0) {
+        ttyReadLine(line, portMAX_DELAY);
+        value = line.text;
+        value.trim();
+    }
     
-    if (WiFi.status() == WL_CONNECTED) {
-        printLine("Already connected!");
-        printLine("SSID: " + WiFi.SSID());
-        printLine("IP: " + WiFi.localIP().toString());
-        printLine("RSSI: " + String(WiFi.RSSI()) + " dBm");
-        inputLocked = false;
+    ttySetEcho(TTY_ECHO_ON);
+    return value;
+}
+
+// Connection state machine, driven by WiFi events. A connect attempt first
+// goes straight to the BSSID and channel the profile last used, which skips
+// the all-channel scan; if that fails it retries with a normal scan, then
+// moves on to the next saved profile. After each full pass over the
+// profiles the retry delay doubles, up to WIFI_RETRY_MAX_MS.
+
+static EventGroupHandle_t wifiEvents = NULL;
+static TimerHandle_t retryTimer = NULL;
+static WifiProfile attempt;           // what the current WiFi.begin() used
+static bool attemptFast = false;
+static int attemptIndex = 0;          // position in the MRU profile list
+static int failedPasses = 0;
+static volatile bool autoConnect = false;
+static uint32_t connectStart = 0;
+static uint32_t lastTimeToIp = 0;
+static uint32_t lastIpAt = 0;
+static bool lastWasFast = false;
+
+static void beginAttempt(const WifiProfile& profile, bool fast) {
+    attempt = profile;
+    attemptFast = fast && profile.channel != 0;
+    connectStart = millis();
+    networkStatus = NET_CONNECTING;
+    xEventGroupClearBits(wifiEvents, WIFI_GOT_IP_BIT | WIFI_FAILED_BIT);
+
+    if (attemptFast) {
+        WiFi.begin(profile.ssid, profile.pass, profile.channel, profile.bssid);
+    } else {
+        WiFi.begin(profile.ssid, profile.pass);
+    }
+}
+
+// Picks the next attempt after a failure: the same profile with a scan if
+// the fast path failed, otherwise the next profile.
+static void nextAttempt() {
+    WifiProfile profiles[WIFI_MAX_PROFILES];
+    int count = loadProfiles(profiles);
+    if (count == 0) return;
+
+    if (attemptFast) {
+        beginAttempt(attempt, false);
         return;
     }
-    
-    while (Serial.available() > 0) Serial.read();
-    
-    printLine("Enter SSID: ");
-    WIFI_SSID = "";
-    while (true) {
-        if (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n' || c == '\r') {
-                if (WIFI_SSID.length() > 0) {
-                    Serial.println();
-                    break;
-                }
-            } else if (c == '\b' || c == 127) {
-                if (WIFI_SSID.length() > 0) {
-                    WIFI_SSID.remove(WIFI_SSID.length() - 1);
-                    Serial.write('\b'); Serial.write(' '); Serial.write('\b');
-                }
-            } else if (c >= 32 && c <= 126) {
-                WIFI_SSID += c;
-                Serial.write(c);
-            }
-        }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+
+    attemptIndex++;
+    if (attemptIndex >= count) {
+        attemptIndex = 0;
+        failedPasses++;
+        uint32_t delayMs = WIFI_RETRY_MIN_MS << min(failedPasses, 6);
+        if (delayMs > WIFI_RETRY_MAX_MS) delayMs = WIFI_RETRY_MAX_MS;
+        Serial.printf("[WIFI] no saved network reachable, retry in %lu ms\n",
+                      (unsigned long)delayMs);
+        xTimerChangePeriod(retryTimer, pdMS_TO_TICKS(delayMs), 0);
+        xTimerStart(retryTimer, 0);
+        return;
     }
-    WIFI_SSID.trim();
-    
-    while (Serial.available() > 0) Serial.read();
-    
-    printLine("Enter Password: ");
-    WIFI_PASS = "";
-    while (true) {
-        if (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n' || c == '\r') {
-                if (WIFI_PASS.length() > 0) {
-                    Serial.println();
-                    break;
-                }
-            } else if (c == '\b' || c == 127) {
-                if (WIFI_PASS.length() > 0) {
-                    WIFI_PASS.remove(WIFI_PASS.length() - 1);
-                    Serial.write('\b'); Serial.write(' '); Serial.write('\b');
-                }
-            } else if (c >= 32 && c <= 126) {
-                WIFI_PASS += c;
-                Serial.write('*');
+    beginAttempt(profiles[attemptIndex], true);
+}
+
+static void retryCallback(TimerHandle_t timer) {
+    if (!autoConnect || WiFi.status() == WL_CONNECTED) return;
+
+    WifiProfile profiles[WIFI_MAX_PROFILES];
+    if (loadProfiles(profiles) > 0) beginAttempt(profiles[0], true);
+}
+
+// True when the stored profile already matches and is the most recent one,
+// so a connect does not have to rewrite the NVS blob.
+static bool profileCurrent(const WifiProfile& profile) {
+    WifiProfile profiles[WIFI_MAX_PROFILES];
+    if (loadProfiles(profiles) == 0) return false;
+
+    const WifiProfile& first = profiles[0];
+    return strcmp(first.ssid, profile.ssid) == 0 &&
+           strcmp(first.pass, profile.pass) == 0 &&
+           memcmp(first.bssid, profile.bssid, 6) == 0 &&
+           first.channel == profile.channel;
+}
+
+static void wifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP: {
+            lastIpAt = millis();
+            lastTimeToIp = lastIpAt - connectStart;
+            lastWasFast = attemptFast;
+            networkStatus = NET_CONNECTED;
+            failedPasses = 0;
+            attemptIndex = 0;
+            autoConnect = true;
+
+            // Remember where we associated so the next connect can skip
+            // the scan.
+            memcpy(attempt.bssid, WiFi.BSSID(), 6);
+            attempt.channel = WiFi.channel();
+            if (!profileCurrent(attempt)) saveProfile(attempt);
+            WIFI_SSID = attempt.ssid;
+            WIFI_PASS = attempt.pass;
+
+            Serial.printf("[WIFI] %s: IP after %lu ms (%s)\n", attempt.ssid,
+                          (unsigned long)lastTimeToIp, lastWasFast ? "fast" : "scan");
+            timeSyncStart();
+            xEventGroupSetBits(wifiEvents, WIFI_GOT_IP_BIT);
+            break;
+        }
+
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            networkStatus = autoConnect ? NET_CONNECTING : NET_DISCONNECTED;
+            // The next network may have a different resolver.
+            dnsCacheFlush();
+            xEventGroupSetBits(wifiEvents, WIFI_FAILED_BIT);
+            if (autoConnect) {
+                Serial.printf("[WIFI] disconnected (reason %d)\n",
+                              info.wifi_sta_disconnected.reason);
+                nextAttempt();
             }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Registers the event handler and, if profiles are saved, starts
+// connecting to the most recently used one without waiting for it.
+void wifiInit() {
+    wifiEvents = xEventGroupCreate();
+    retryTimer = xTimerCreate("wifiretry", pdMS_TO_TICKS(WIFI_RETRY_MIN_MS), pdFALSE,
+                              NULL, retryCallback);
+
+    WiFi.persistent(false);
+    WiFi.setAutoReconnect(false);
+    WiFi.mode(WIFI_STA);
+    WiFi.onEvent(wifiEvent);
+
+    WifiProfile profiles[WIFI_MAX_PROFILES];
+    if (loadProfiles(profiles) > 0) {
+        autoConnect = true;
+        attemptIndex = 0;
+        beginAttempt(profiles[0], true);
+    }
+}
+
+// Returns true once an IP arrives, false on timeout or when the attempt
+// fails. A disconnect reported right after begin() belongs to whatever
+// was running before and is ignored.
+static bool waitForIp(uint32_t timeoutMs) {
+    while (millis() - connectStart < timeoutMs) {
+        EventBits_t bits = xEventGroupWaitBits(wifiEvents, WIFI_GOT_IP_BIT | WIFI_FAILED_BIT,
+                                               pdFALSE, pdFALSE, pdMS_TO_TICKS(100));
+        if (bits & WIFI_GOT_IP_BIT) return true;
+        if (bits & WIFI_FAILED_BIT) {
+            if (millis() - connectStart > WIFI_STALE_EVENT_MS) return false;
+            xEventGroupClearBits(wifiEvents, WIFI_FAILED_BIT);
         }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
     }
-    WIFI_PASS.trim();
-    
-    inputLocked = false;
-    
-    printLine("Connecting to: " + WIFI_SSID);
-    WiFi.begin(WIFI_SSID.c_str(), WIFI_PASS.c_str());
-    
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 10) {
-        vTaskDelay(500 / portTICK_PERIOD_MS);
-        Serial.print(".");
-        tft.print(".");
-        attempts++;
+    return false;
+}
+
+static void reportConnected() {
+    printLine("Connected in " + String(lastTimeToIp) + "ms");
+    printLine("SSID: " + WiFi.SSID());
+    printLine("IP: " + WiFi.localIP().toString());
+    printLine("RSSI: " + String(WiFi.RSSI()) + " dBm");
+}
+
+static void connectProfile(const WifiProfile& profile) {
+    printLine("Connecting to: " + String(profile.ssid));
+    autoConnect = false;
+    xTimerStop(retryTimer, 0);
+    if (WiFi.status() == WL_CONNECTED) {
+        WiFi.disconnect();
+        vTaskDelay(WIFI_STALE_EVENT_MS / portTICK_PERIOD_MS);
     }
-    
+    attemptIndex = 0;
+    beginAttempt(profile, true);
+
+    // With autoConnect off the event handler does not fall back to a scan,
+    // so do it here.
+    if (!waitForIp(WIFI_CONNECT_TIMEOUT_MS) && attemptFast) {
+        beginAttempt(profile, false);
+        waitForIp(WIFI_CONNECT_TIMEOUT_MS);
+    }
+
     if (WiFi.status() == WL_CONNECTED) {
-        printLine("");
-        printLine("Connected!");
+        reportConnected();
+    } else {
+        WiFi.disconnect();
+        networkStatus = NET_FAILED;
+        printLine("Failed to connect.");
+    }
+}
+
+void connectWiFi() {
+    if (WiFi.status() == WL_CONNECTED) {
+        printLine("Already connected!");
         printLine("SSID: " + WiFi.SSID());
         printLine("IP: " + WiFi.localIP().toString());
         printLine("RSSI: " + String(WiFi.RSSI()) + " dBm");
-        syncTime();
+        return;
+    }
+    
+    WifiProfile profile;
+    memset(&profile, 0, sizeof(profile));
+    String ssid = promptLine("Enter SSID: ", TTY_ECHO_ON);
+    String pass = promptLine("Enter Password: ", TTY_ECHO_MASK);
+    strlcpy(profile.ssid, ssid.c_str(), sizeof(profile.ssid));
+    strlcpy(profile.pass, pass.c_str(), sizeof(profile.pass));
+
+    // Keep the saved BSSID and channel when re-entering a known network
+    WifiProfile known;
+    if (findProfile(profile.ssid, known) && strcmp(known.pass, profile.pass) == 0) {
+        profile = known;
+    }
+    connectProfile(profile);
+}
+
+void connectSavedWiFi(String ssid) {
+    WifiProfile profile;
+    if (!findProfile(ssid.c_str(), profile)) {
+        printLine("wifi: no saved profile '" + ssid + "'");
+        return;
+    }
+    if (WiFi.status() == WL_CONNECTED && WiFi.SSID() == ssid) {
+        printLine("Already connected to " + ssid);
+        return;
+    }
+    connectProfile(profile);
+}
+
+void listWiFiProfiles() {
+    WifiProfile profiles[WIFI_MAX_PROFILES];
+    int count = loadProfiles(profiles);
+    if (count == 0) {
+        printLine("No saved networks");
+        return;
+    }
+
+    bool connected = WiFi.status() == WL_CONNECTED;
+    for (int i = 0; i < count; i++) {
+        const WifiProfile& p = profiles[i];
+        char line[80];
+        if (p.channel) {
+            sprintf(line, "%c %-24.24s ch %2d %02X:%02X:%02X:%02X:%02X:%02X",
+                    connected && WiFi.SSID() == p.ssid ? '*' : ' ', p.ssid, p.channel,
+                    p.bssid[0], p.bssid[1], p.bssid[2], p.bssid[3], p.bssid[4], p.bssid[5]);
+        } else {
+            sprintf(line, "  %-24.24s (never connected)", p.ssid);
+        }
+        printLine(line);
+    }
+}
+
+void forgetWiFiProfile(String ssid) {
+    if (forgetProfile(ssid.c_str())) {
+        printLine("Forgot " + ssid);
     } else {
-        printLine("");
-        printLine("Failed to connect.");
+        printLine("wifi: no saved profile '" + ssid + "'");
     }
 }
 
 void disconnectWiFi() {
+    autoConnect = false;
+    xTimerStop(retryTimer, 0);
+
     if (WiFi.status() != WL_CONNECTED) {
+        WiFi.disconnect();
+        networkStatus = NET_DISCONNECTED;
         printLine("Not connected to WiFi");
         return;
     }
     
     WiFi.disconnect();
     networkStatus = NET_DISCONNECTED;
+    dnsCacheFlush();
     printLine("WiFi disconnected");
 }
 
-void scanWiFi() {
-    printLine("Scanning networks...");
-    
-    int n = WiFi.scanNetworks();
-    
-    if (n == 0) {
-        printLine("No networks found");
-    } else {
-        printLine("Found " + String(n) + " networks:");
-        printLine("");
-        printLine("  SSID                   RSSI  Ch  Enc");
-        printLine("  ----------------------------------------");
-        
-        for (int i = 0; i < n; i++) {
-            String ssid = WiFi.SSID(i);
-            if (ssid.length() > 20) ssid = ssid.substring(0, 20);
-            
-            String encryption;
-            switch (WiFi.encryptionType(i)) {
-                case WIFI_AUTH_OPEN: encryption = "Open"; break;
-                case WIFI_AUTH_WEP: encryption = "WEP"; break;
-                case WIFI_AUTH_WPA_PSK: encryption = "WPA"; break;
-                case WIFI_AUTH_WPA2_PSK: encryption = "WPA2"; break;
-                case WIFI_AUTH_WPA_WPA2_PSK: encryption = "WPA/2"; break;
-                default: encryption = "WPA2"; break;
-            }
-            
-            char line[60];
-            sprintf(line, "%2d %-20s %4d  %2d  %s",
-                    i + 1,
-                    ssid.c_str(),
-                    WiFi.RSSI(i),
-                    WiFi.channel(i),
-                    encryption.c_str());
-            printLine(line);
-        }
-    }
-    
-    WiFi.scanDelete();
-}
-
 void showNetworkInfo() {
     if (WiFi.status() != WL_CONNECTED) {
-        printLine("Not connected to WiFi");
+        printLine(networkStatus == NET_CONNECTING ? "Not connected, reconnecting to saved networks"
+                                                   : "Not connected to WiFi");
         return;
     }
     
@@ -166,6 +329,9 @@ void showNetworkInfo() {
     printLine("MAC: " + WiFi.macAddress());
     printLine("RSSI: " + String(WiFi.RSSI()) + " dBm");
     printLine("Channel: " + String(WiFi.channel()));
+    printLine("Time to IP: " + String(lastTimeToIp) + "ms (" +
+              (lastWasFast ? "saved BSSID" : "scan") + "), at " +
+              String(lastIpAt / 1000.0f, 2) + "s after boot");
 }
 
 bool isConnected() {
@@ -195,6 +361,42 @@ void curlURLVerbose(String url) {
     curlWithOptions(opts);
 }
 
+static void curlPrintBody(HTTPClient& http, size_t limit, HttpStreamResult& result) {
+    PrintSinkState state;
+    state.length = 0;
+    httpStreamBody(http, printSink, &state, limit, result);
+    printSinkFlush(state);
+}
+
+static bool curlToFile(HTTPClient& http, const CurlOptions& opts) {
+    String path = vfsPath(opts.outFile);
+    
+    File f = vfs().open(path, FILE_WRITE);
+    if (!f) {
+        printLine("curl: cannot open " + path);
+        return false;
+    }
+    
+    HttpStreamResult result;
+    httpStreamBody(http, fileSink, &f, 0, result);
+    f.close();
+    fsCacheUpdate(path);
+    
+    if (!result.complete) {
+        printLine(result.timedOut ? "curl: timed out, file is partial"
+                                  : "curl: transfer incomplete, file is partial");
+    }
+    
+    float kbps = result.elapsedMs > 0 ? result.bytes / 1.024f / result.elapsedMs : 0;
+    printLine("Saved " + formatBytes(result.bytes) + " to " + path +
+              " (" + String(kbps, 1) + " KB/s)");
+    if (opts.verbose) {
+        printLine("< Peak heap: +" + formatBytes(result.peakHeap) +
+                  (result.chunked ? " (chunked)" : ""));
+    }
+    return result.complete;
+}
+
 void curlWithOptions(CurlOptions opts) {
     if (!isConnected()) {
         printLine("curl: not connected to WiFi");
@@ -207,50 +409,59 @@ void curlWithOptions(CurlOptions opts) {
         return;
     }
 
-    HTTPClient http;
-    http.begin(opts.url);
-    http.setTimeout(opts.timeout);
-    
-    if (opts.followRedirects) {
-        http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    }
-    
-    http.setUserAgent(opts.userAgent);
+    String url = opts.url;
+    HTTPClient* client = httpAcquire(url);
+    unsigned long startTime = millis();
+    int code = 0;
     
-    for (int i = 0; i < opts.headerCount; i++) {
-        int colonPos = opts.headers[i].indexOf(':');
-        if (colonPos > 0) {
-            String headerName = opts.headers[i].substring(0, colonPos);
-            String headerValue = opts.headers[i].substring(colonPos + 1);
-            headerValue.trim();
-            http.addHeader(headerName, headerValue);
+    for (int hop = 0; client != NULL; hop++) {
+        client->setTimeout(opts.timeout);
+        client->setUserAgent(opts.userAgent);
+        
+        for (int i = 0; i < opts.headerCount; i++) {
+            int colonPos = opts.headers[i].indexOf(':');
+            if (colonPos > 0) {
+                String headerName = opts.headers[i].substring(0, colonPos);
+                String headerValue = opts.headers[i].substring(colonPos + 1);
+                headerValue.trim();
+                client->addHeader(headerName, headerValue);
+            }
+        }
+        
+        if (opts.verbose) {
+            printLine("> " + opts.method + " " + url);
+            if (hop == 0) printLine("> User-Agent: " + opts.userAgent);
+            if (httpWasReused(client)) printLine("* Reusing connection");
+        }
+        
+        if (opts.method == "POST") {
+            code = client->POST(opts.data);
+        } else if (opts.method == "PUT") {
+            code = client->PUT(opts.data);
+        } else if (opts.method == "DELETE") {
+            code = client->sendRequest("DELETE");
+        } else {
+            code = client->GET();
+        }
+        
+        if (!opts.followRedirects || opts.method != "GET" || hop >= HTTP_MAX_REDIRECTS ||
+            !httpRedirect(client, code, url)) {
+            break;
         }
     }
     
-    if (opts.verbose) {
-        printLine("> " + opts.method + " " + opts.url);
-        printLine("> User-Agent: " + opts.userAgent);
-    }
-    
-    unsigned long startTime = millis();
-    int code;
-    
-    if (opts.method == "POST") {
-        code = http.POST(opts.data);
-    } else if (opts.method == "PUT") {
-        code = http.PUT(opts.data);
-    } else if (opts.method == "DELETE") {
-        code = http.sendRequest("DELETE");
-    } else {
-        code = http.GET();
+    if (client == NULL) {
+        printLine("curl: cannot connect to " + url);
+        return;
     }
+    HTTPClient& http = *client;
     
     unsigned long duration = millis() - startTime;
     
     if (code <= 0) {
         printLine("curl: connection failed");
         printLine("Error: " + http.errorToString(code));
-        http.end();
+        httpRelease(client, false);
         return;
     }
 
@@ -275,7 +486,10 @@ void curlWithOptions(CurlOptions opts) {
     }
 
     
-    if (code == HTTP_CODE_OK) {
+    bool drained = false;
+    if (code == HTTP_CODE_OK && opts.outFile.length() > 0) {
+        drained = curlToFile(http, opts);
+    } else if (code == HTTP_CODE_OK) {
         int contentLength = http.getSize();
         String contentType = http.header("Content-Type");
         
@@ -283,20 +497,29 @@ void curlWithOptions(CurlOptions opts) {
             printLine("Binary content (" + contentType + ")");
             printLine("Size: " + formatBytes(contentLength));
             printLine("Cannot display binary data");
+            printLine("Use 'curl -o <file> <url>' to save it");
         } else {
-           
-            String payload = http.getString();
-            int len = payload.length();
+            HttpStreamResult result;
+            curlPrintBody(http, CURL_DISPLAY_LIMIT, result);
+            drained = result.complete;
             
-            if (len > 1500) {
-                printLine(payload.substring(0, 1500));
-                printLine("");
-                printLine("... (+" + String(len - 1500) + " bytes)");
-                printLine("Response truncated at 1500 bytes");
-            } else if (len > 0) {
-                printLine(payload);
-            } else {
+            if (result.bytes == 0 && result.complete) {
                 printLine("(empty response)");
+            } else if (!result.complete && result.bytes >= CURL_DISPLAY_LIMIT) {
+                printLine("");
+                if (contentLength > 0) {
+                    printLine("... (+" + String(contentLength - (int)result.bytes) + " bytes)");
+                }
+                printLine("Response truncated at " + String(CURL_DISPLAY_LIMIT) + " bytes");
+            } else if (result.timedOut) {
+                printLine("curl: timed out reading body");
+            }
+            
+            if (opts.verbose) {
+                printLine("< Body: " + String(result.bytes) + " bytes in " +
+                          String(result.elapsedMs) + "ms" +
+                          (result.chunked ? " (chunked)" : "") +
+                          ", peak heap +" + formatBytes(result.peakHeap));
             }
         }
     } else if (code >= 300 && code < 400) {
@@ -306,46 +529,251 @@ void curlWithOptions(CurlOptions opts) {
     } else if (code >= 400) {
         
         printLine("Error " + String(code) + ": " + getStatusText(code));
-        String payload = http.getString();
-        if (payload.length() > 300) {
-            printLine(payload.substring(0, 300) + "...");
-        } else if (payload.length() > 0) {
-            printLine(payload);
+        HttpStreamResult result;
+        curlPrintBody(http, CURL_ERROR_LIMIT, result);
+        drained = result.complete;
+        if (!result.complete && result.bytes >= CURL_ERROR_LIMIT) {
+            printLine("...");
         }
     }
 
-    http.end();
+    httpRelease(client, drained);
+}
+
+struct WgetSink {
+    File* file;
+    size_t written;
+    size_t total;
+    uint32_t started;
+    uint32_t lastReport;
+    const char* path;
+};
+
+static bool wgetSink(const uint8_t* data, size_t len, void* ctx) {
+    WgetSink* sink = (WgetSink*)ctx;
+    if (sink->file->write(data, len) != len) {
+        printLine("wget: write failed (filesystem full?)");
+        return false;
+    }
+    sink->written += len;
+
+    uint32_t now = millis();
+    if (now - sink->lastReport >= WGET_PROGRESS_MS) {
+        String line = "wget: " + String(sink->path) + " " + formatBytes(sink->written);
+        if (sink->total > 0) {
+            line += " / " + formatBytes(sink->total);
+        }
+        line += " (" + String(sink->written / 1.024f / (now - sink->started), 1) + " KB/s)";
+        printLine(line);
+        sink->lastReport = now;
+    }
+    return true;
 }
 
+// One request for the bytes from the file's current size onwards. Returns
+// true when the file is complete, false if it should be retried.
+static bool wgetAttempt(const WgetParams& params, WgetSink& sink, bool& fatal) {
+    size_t offset = 0;
+    if (vfs().exists(params.path)) {
+        File existing = vfs().open(params.path, FILE_READ);
+        offset = existing.size();
+        existing.close();
+    }
+
+    String url = params.url;
+    HTTPClient* client = httpAcquire(url);
+    int code = 0;
+    for (int hop = 0; client != NULL; hop++) {
+        client->setUserAgent("MiniOS-wget/1.0");
+        if (offset > 0) {
+            client->addHeader("Range", "bytes=" + String(offset) + "-");
+        }
+        code = client->GET();
+        if (hop >= HTTP_MAX_REDIRECTS || !httpRedirect(client, code, url)) break;
+    }
+    if (client == NULL) {
+        printLine("wget: cannot connect to " + url);
+        return false;
+    }
+    HTTPClient& http = *client;
+
+    if (code <= 0) {
+        printLine("wget: " + http.errorToString(code));
+        httpRelease(client, false);
+        return false;
+    }
+
+    if (code == 416 && offset > 0) {
+        // Nothing past our end: the file is already complete
+        httpRelease(client, false);
+        sink.total = offset;
+        return true;
+    }
+
+    const char* mode = FILE_APPEND;
+    if (code == 206) {
+        String range = http.header("Content-Range");
+        if (!range.startsWith("bytes " + String(offset) + "-")) {
+            printLine("wget: unexpected Content-Range: " + range);
+            httpRelease(client, false);
+            fatal = true;
+            return false;
+        }
+        int slash = range.indexOf('/');
+        if (slash > 0 && range[slash + 1] != '*') {
+            sink.total = range.substring(slash + 1).toInt();
+        }
+        if (sink.written == 0) {
+            printLine("wget: resuming at " + formatBytes(offset));
+        }
+    } else if (code == HTTP_CODE_OK) {
+        if (offset > 0) {
+            printLine("wget: server ignored Range, starting over");
+        }
+        mode = FILE_WRITE;
+        offset = 0;
+        sink.total = http.getSize() > 0 ? http.getSize() : 0;
+    } else {
+        printLine("wget: HTTP " + String(code) + " " + getStatusText(code));
+        httpRelease(client, false);
+        fatal = true;
+        return false;
+    }
+
+    size_t free = vfsTotalBytes() - vfsUsedBytes();
+    if (sink.total > offset && sink.total - offset > free) {
+        printLine("wget: needs " + formatBytes(sink.total - offset) + ", only " +
+                  formatBytes(free) + " free");
+        httpRelease(client, false);
+        fatal = true;
+        return false;
+    }
+
+    File file = vfs().open(params.path, mode);
+    if (!file) {
+        printLine("wget: cannot open " + params.path);
+        httpRelease(client, false);
+        fatal = true;
+        return false;
+    }
+
+    sink.file = &file;
+    HttpStreamResult result;
+    httpStreamBody(http, wgetSink, &sink, 0, result);
+    file.close();
+    fsCacheUpdate(params.path);
+    httpRelease(client, result.complete);
+
+    if (!result.complete && result.timedOut) {
+        printLine("wget: connection stalled");
+    }
+    return result.complete;
+}
+
+// Runs as its own process so the shell stays usable during long downloads.
+// Interrupted transfers are picked up where the file ends with a Range
+// request, both on retry here and when wget is run again later.
+void wgetProcess(void* parameter) {
+    WgetParams* params = (WgetParams*)parameter;
+
+    WgetSink sink;
+    sink.file = NULL;
+    sink.written = 0;
+    sink.total = 0;
+    sink.started = millis();
+    sink.lastReport = sink.started;
+    sink.path = params->path.c_str();
+
+    bool done = false;
+    bool fatal = false;
+    for (int attempt = 0; attempt <= WGET_RETRIES && !done && !fatal; attempt++) {
+        if (attempt > 0) {
+            printLine("wget: retrying (" + String(attempt) + "/" + String(WGET_RETRIES) + ")");
+            vTaskDelay(WGET_RETRY_DELAY_MS / portTICK_PERIOD_MS);
+        }
+        done = wgetAttempt(*params, sink, fatal);
+    }
+
+    uint32_t elapsed = millis() - sink.started;
+    if (done && sink.written == 0) {
+        printLine("wget: " + params->path + " is already complete");
+    } else if (done) {
+        printLine("wget: saved " + params->path + " (" + formatBytes(sink.written) +
+                  " in " + String(elapsed / 1000.0f, 1) + " s, " +
+                  String(elapsed > 0 ? sink.written / 1.024f / elapsed : 0, 1) + " KB/s)");
+    } else {
+        printLine("wget: failed, " + formatBytes(sink.written) + " received; run again to resume");
+    }
+
+    delete params;
+    exitProcess();
+}
+
+void wgetCommand(String url, String path) {
+    if (!isConnected()) {
+        printLine("wget: not connected to WiFi");
+        return;
+    }
+    if (!url.startsWith("http://") && !url.startsWith("https://")) {
+        printLine("wget: invalid URL (must start with http:// or https://)");
+        return;
+    }
+
+    WgetParams* params = new WgetParams;
+    params->url = url;
+    params->path = vfsPath(path);
+
+    int pid = createProcess(wgetProcess, "wget", WGET_STACK, 1, params);
+    if (pid < 0) {
+        printLine("wget: cannot start process");
+        delete params;
+        return;
+    }
+    printLine("wget: downloading to " + params->path + " (PID " + String(pid) + ")");
+}
+
+// Both helpers retry once on a fresh connection when a kept-alive one turns
+// out to have been closed by the server.
 String httpGet(String url) {
     if (!isConnected()) return "";
     
-    HTTPClient http;
-    http.begin(url);
-    http.setTimeout(10000);
-    
-    int code = http.GET();
     String result = "";
-    
-    if (code == HTTP_CODE_OK) {
-        result = http.getString();
+    for (int attempt = 0; attempt < 2; attempt++) {
+        HTTPClient* http = httpAcquire(url);
+        if (http == NULL) return "";
+        http->setTimeout(10000);
+        
+        bool reused = httpWasReused(http);
+        int code = http->GET();
+        
+        String body = code > 0 ? http->getString() : "";
+        if (code == HTTP_CODE_OK) {
+            result = body;
+        }
+        httpRelease(http, code > 0);
+        
+        if (code > 0 || !reused) break;
     }
-    
-    http.end();
     return result;
 }
 
 int httpPost(String url, String data) {
     if (!isConnected()) return -1;
     
-    HTTPClient http;
-    http.begin(url);
-    http.addHeader("Content-Type", "application/json");
-    http.setTimeout(10000);
-    
-    int code = http.POST(data);
-    http.end();
-    
+    int code = -1;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        HTTPClient* http = httpAcquire(url);
+        if (http == NULL) return -1;
+        http->addHeader("Content-Type", "application/json");
+        http->setTimeout(10000);
+        
+        bool reused = httpWasReused(http);
+        code = http->POST(data);
+        if (code > 0) http->getString();
+        httpRelease(http, code > 0);
+        
+        if (code > 0 || !reused) break;
+    }
     return code;
 }
 
@@ -359,7 +787,7 @@ void pingHost(String host) {
     printLine("PING " + host);
     
     IPAddress ip;
-    if (!WiFi.hostByName(host.c_str(), ip)) {
+    if (!dnsResolve(host.c_str(), ip)) {
         printLine("ping: cannot resolve " + host);
         return;
     }
@@ -411,6 +839,11 @@ void pingHost(String host) {
 }
 
 void dnsLookup(String hostname) {
+    if (hostname == "-c") {
+        dnsCacheShow();
+        return;
+    }
+    
     if (!isConnected()) {
         printLine("dns: not connected to WiFi");
         return;
@@ -419,10 +852,17 @@ void dnsLookup(String hostname) {
     printLine("Looking up: " + hostname);
     
     IPAddress ip;
-    if (WiFi.hostByName(hostname.c_str(), ip)) {
-        printLine("IP Address: " + ip.toString());
+    DnsSource source;
+    unsigned long start = millis();
+    bool found = dnsResolve(hostname.c_str(), ip, &source);
+    unsigned long elapsed = millis() - start;
+    
+    String how = source == DNS_CACHED ? " (cached)" :
+                 source == DNS_QUERIED ? " (" + String(elapsed) + "ms)" : "";
+    if (found) {
+        printLine("IP Address: " + ip.toString() + how);
     } else {
-        printLine("DNS lookup failed");
+        printLine("DNS lookup failed" + how);
     }
 }
 
@@ -467,23 +907,3 @@ bool isBinaryContent(String contentType) {
            contentType.indexOf("application/zip") >= 0 ||
            contentType.indexOf("application/octet-stream") >= 0;
 }
-
-
-
-void curlProcess(void* parameter) {
-    CurlParams* params = (CurlParams*)parameter;
-    
-    extern bool inputLocked;
-    inputLocked = true;
-    
-    if (params->verbose) {
-        curlURLVerbose(params->url);
-    } else {
-        curlURL(params->url);
-    }
-    
-    delete params;
-    inputLocked = false;
-    
-    vTaskDelete(NULL);
-}
\ No newline at end of file
@@ -0,0 +1,376 @@
+#include "pingmon.h"
+#include "display.h"
+#include "console.h"
+#include "theme.h"
+#include "kernel.h"
+#include "dnscache.h"
+#include "tty.h"
+#include <WiFi.h>
+#include <esp_system.h>
+#include <freertos/semphr.h>
+#include "lwip/sockets.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/icmp.h"
+#include "lwip/ip.h"
+
+// Background latency monitor. Each round sends one ICMP echo to every host
+// from a single raw socket and then collects the replies as they arrive,
+// so a slow or dead host costs the others nothing. The sequence number
+// carries the host index and the payload the send time, so a reply needs
+// no lookup to be scored.
+
+#define PING_PAYLOAD 24
+#define SEQ_HOST_BITS 3
+
+struct PingHost {
+    char name[DNS_HOST_MAX];
+    IPAddress ip;
+    uint16_t samples[PINGMON_SAMPLES];
+    int head;              // next slot to write
+    int count;             // valid samples, up to PINGMON_SAMPLES
+    uint32_t sent;
+    uint32_t received;
+};
+
+struct PingStats {
+    int last;              // -1 if the last probe was lost
+    int p50, p95, p99;     // -1 with no replies in the window
+    int lossPercent;
+    int maxMs;
+};
+
+static PingHost hosts[PINGMON_MAX_HOSTS];
+static int hostCount = 0;
+static int interval = PINGMON_INTERVAL_MS;
+static uint32_t rounds = 0;
+static volatile bool running = false;
+static volatile bool stopRequested = false;
+static SemaphoreHandle_t monMutex = NULL;
+
+static void record(PingHost& h, uint16_t ms) {
+    h.samples[h.head] = ms;
+    h.head = (h.head + 1) % PINGMON_SAMPLES;
+    if (h.count < PINGMON_SAMPLES) h.count++;
+    if (ms != PINGMON_LOST) h.received++;
+}
+
+static bool sendEcho(int sock, const IPAddress& ip, uint16_t id, uint16_t seq) {
+    uint8_t packet[sizeof(struct icmp_echo_hdr) + PING_PAYLOAD];
+    struct icmp_echo_hdr* echo = (struct icmp_echo_hdr*)packet;
+
+    memset(packet, 0, sizeof(packet));
+    ICMPH_TYPE_SET(echo, ICMP_ECHO);
+    ICMPH_CODE_SET(echo, 0);
+    echo->id = htons(id);
+    echo->seqno = htons(seq);
+    uint32_t sentAt = micros();
+    memcpy(packet + sizeof(struct icmp_echo_hdr), &sentAt, sizeof(sentAt));
+    echo->chksum = inet_chksum(packet, sizeof(packet));
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = (uint32_t)ip;
+
+    return sendto(sock, packet, sizeof(packet), 0, (struct sockaddr*)&to, sizeof(to)) > 0;
+}
+
+// Waits up to timeoutMs for the replies to this round. pending has a bit
+// per host still outstanding; replies clear it.
+static void collectReplies(int sock, uint16_t id, uint16_t round, uint32_t& pending,
+                           uint32_t timeoutMs) {
+    uint8_t buf[64 + sizeof(struct icmp_echo_hdr) + PING_PAYLOAD];
+    uint32_t start = millis();
+
+    while (pending) {
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= timeoutMs) break;
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(sock, &readSet);
+        struct timeval tv;
+        tv.tv_sec = (timeoutMs - elapsed) / 1000;
+        tv.tv_usec = ((timeoutMs - elapsed) % 1000) * 1000;
+        if (select(sock + 1, &readSet, NULL, NULL, &tv) <= 0) break;
+
+        int len = recv(sock, buf, sizeof(buf), 0);
+        uint32_t now = micros();
+        if (len < (int)sizeof(struct ip_hdr)) continue;
+
+        struct ip_hdr* iph = (struct ip_hdr*)buf;
+        int headerLen = IPH_HL(iph) * 4;
+        if (len < headerLen + (int)sizeof(struct icmp_echo_hdr) + (int)sizeof(uint32_t)) continue;
+
+        struct icmp_echo_hdr* echo = (struct icmp_echo_hdr*)(buf + headerLen);
+        if (ICMPH_TYPE(echo) != ICMP_ER || ntohs(echo->id) != id) continue;
+
+        uint16_t seq = ntohs(echo->seqno);
+        int index = seq & ((1 << SEQ_HOST_BITS) - 1);
+        if ((seq >> SEQ_HOST_BITS) != round || index >= hostCount) continue;
+        if (!(pending & (1u << index))) continue;
+
+        uint32_t sentAt;
+        memcpy(&sentAt, buf + headerLen + sizeof(struct icmp_echo_hdr), sizeof(sentAt));
+        uint32_t ms = (now - sentAt + 500) / 1000;
+        if (ms >= PINGMON_LOST) ms = PINGMON_LOST - 1;
+
+        xSemaphoreTake(monMutex, portMAX_DELAY);
+        record(hosts[index], ms);
+        xSemaphoreGive(monMutex);
+        pending &= ~(1u << index);
+    }
+}
+
+void pingmonProcess(void* parameter) {
+    int sock = socket(AF_INET, SOCK_RAW, IP_PROTO_ICMP);
+    if (sock < 0) {
+        printLine("pingmon: cannot open ICMP socket");
+        running = false;
+        exitProcess();
+        return;
+    }
+
+    uint16_t id = (uint16_t)(esp_random() & 0xFFFF);
+    uint32_t timeout = min(interval, PINGMON_TIMEOUT_MS);
+    TickType_t wake = xTaskGetTickCount();
+
+    while (!stopRequested) {
+        uint16_t round = (uint16_t)(rounds & (0xFFFF >> SEQ_HOST_BITS));
+        uint32_t pending = 0;
+
+        for (int i = 0; i < hostCount; i++) {
+            PingHost& h = hosts[i];
+            IPAddress ip;
+            bool ok = WiFi.status() == WL_CONNECTED && dnsResolve(h.name, ip);
+
+            xSemaphoreTake(monMutex, portMAX_DELAY);
+            if (ok) h.ip = ip;
+            h.sent++;
+            if (!ok) record(h, PINGMON_LOST);
+            xSemaphoreGive(monMutex);
+
+            if (!ok) continue;
+            if (sendEcho(sock, ip, id, (round << SEQ_HOST_BITS) | i)) {
+                pending |= 1u << i;
+            } else {
+                xSemaphoreTake(monMutex, portMAX_DELAY);
+                record(h, PINGMON_LOST);
+                xSemaphoreGive(monMutex);
+            }
+        }
+
+        collectReplies(sock, id, round, pending, timeout);
+
+        xSemaphoreTake(monMutex, portMAX_DELAY);
+        for (int i = 0; i < hostCount; i++) {
+            if (pending & (1u << i)) record(hosts[i], PINGMON_LOST);
+        }
+        rounds++;
+        xSemaphoreGive(monMutex);
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(interval));
+    }
+
+    close(sock);
+    running = false;
+    exitProcess();
+}
+
+bool pingmonStart(int intervalMs, char** names, int count) {
+    if (running) {
+        printLine("pingmon: already running, 'pingmon stop' first");
+        return false;
+    }
+    if (count < 1 || count > PINGMON_MAX_HOSTS) {
+        printLine("pingmon: 1 to " + String(PINGMON_MAX_HOSTS) + " hosts");
+        return false;
+    }
+    if (monMutex == NULL) monMutex = xSemaphoreCreateMutex();
+
+    memset(hosts, 0, sizeof(hosts));
+    for (int i = 0; i < count; i++) {
+        strlcpy(hosts[i].name, names[i], sizeof(hosts[i].name));
+    }
+    hostCount = count;
+    interval = max(intervalMs, PINGMON_MIN_INTERVAL_MS);
+    rounds = 0;
+    stopRequested = false;
+    running = true;
+
+    if (createProcess(pingmonProcess, "pingmon", PINGMON_STACK, 1) < 0) {
+        running = false;
+        printLine("pingmon: cannot start process");
+        return false;
+    }
+    printLine("pingmon: " + String(count) + " hosts every " + String(interval) + "ms");
+    return true;
+}
+
+void pingmonStop() {
+    if (!running) {
+        printLine("pingmon: not running");
+        return;
+    }
+    stopRequested = true;
+    while (running) vTaskDelay(50 / portTICK_PERIOD_MS);
+    printLine("pingmon: stopped");
+}
+
+bool pingmonRunning() {
+    return running;
+}
+
+// Caller holds monMutex or passes a copy.
+static void computeStats(const PingHost& h, PingStats& s) {
+    uint16_t sorted[PINGMON_SAMPLES];
+    int replies = 0;
+    int lost = 0;
+
+    s.last = -1;
+    s.maxMs = 0;
+    for (int i = 0; i < h.count; i++) {
+        uint16_t v = h.samples[(h.head - 1 - i + PINGMON_SAMPLES) % PINGMON_SAMPLES];
+        if (i == 0 && v != PINGMON_LOST) s.last = v;
+        if (v == PINGMON_LOST) {
+            lost++;
+            continue;
+        }
+        int j = replies++;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+        if (v > s.maxMs) s.maxMs = v;
+    }
+
+    s.lossPercent = h.count > 0 ? lost * 100 / h.count : 0;
+    if (replies == 0) {
+        s.p50 = s.p95 = s.p99 = -1;
+        return;
+    }
+    s.p50 = sorted[(replies - 1) * 50 / 100];
+    s.p95 = sorted[(replies - 1) * 95 / 100];
+    s.p99 = sorted[(replies - 1) * 99 / 100];
+}
+
+static void formatMs(char* out, int ms) {
+    if (ms < 0) strcpy(out, "   -");
+    else sprintf(out, "%4d", ms);
+}
+
+static void hostLine(char* line, const PingHost& h, const PingStats& s) {
+    char last[8], p50[8], p95[8], p99[8];
+    formatMs(last, s.last);
+    formatMs(p50, s.p50);
+    formatMs(p95, s.p95);
+    formatMs(p99, s.p99);
+    sprintf(line, "%-18.18s %s %s %s %s %3d%%", h.name, last, p50, p95, p99,
+            s.lossPercent);
+}
+
+#define PINGMON_HEADER "HOST               LAST  P50  P95  P99 LOSS"
+
+void pingmonShow() {
+    if (monMutex == NULL || hostCount == 0) {
+        printLine("pingmon: not started");
+        printLine("Usage: pingmon [-i ms] <host> [host...]");
+        return;
+    }
+
+    char line[80];
+    sprintf(line, "pingmon: %s, %dms interval, %lu rounds", running ? "running" : "stopped",
+            interval, (unsigned long)rounds);
+    printLine(line);
+    printLine(PINGMON_HEADER);
+
+    for (int i = 0; i < hostCount; i++) {
+        PingStats s;
+        xSemaphoreTake(monMutex, portMAX_DELAY);
+        computeStats(hosts[i], s);
+        hostLine(line, hosts[i], s);
+        xSemaphoreGive(monMutex);
+        printLine(line);
+    }
+}
+
+static void viewLine(int y, const char* text) {
+    char padded[CONSOLE_COLS + 1];
+    snprintf(padded, sizeof(padded), "%-*s", CONSOLE_COLS, text);
+    tft.setCursor(CONSOLE_X, y);
+    tft.print(padded);
+}
+
+// Bars for the samples in the window, oldest on the left; lost probes are
+// full-height red bars.
+#define SPARK_H 14
+#define SPARK_BAR 4
+
+static void drawSparkline(int y, const PingHost& h, int scaleMs) {
+    Theme theme = getCurrentTheme();
+    int x = CONSOLE_X;
+
+    for (int i = 0; i < PINGMON_SAMPLES; i++, x += SPARK_BAR) {
+        int age = PINGMON_SAMPLES - 1 - i;
+        int bar = 0;
+        uint16_t colour = theme.fg;
+        if (age < h.count) {
+            uint16_t v = h.samples[(h.head - 1 - age + PINGMON_SAMPLES) % PINGMON_SAMPLES];
+            if (v == PINGMON_LOST) {
+                bar = SPARK_H;
+                colour = ST77XX_RED;
+            } else {
+                bar = 1 + (int)v * (SPARK_H - 1) / scaleMs;
+                if (bar > SPARK_H) bar = SPARK_H;
+            }
+        }
+        tft.fillRect(x, y, SPARK_BAR - 1, SPARK_H - bar, theme.bg);
+        if (bar > 0) tft.fillRect(x, y + SPARK_H - bar, SPARK_BAR - 1, bar, colour);
+    }
+}
+
+// Live table with a sparkline under each host, refreshed until ENTER.
+void pingmonView() {
+    if (monMutex == NULL || hostCount == 0) {
+        printLine("pingmon: not started");
+        return;
+    }
+
+    screenLocked = true;
+    Theme theme = getCurrentTheme();
+    tft.fillScreen(theme.bg);
+    tft.setTextColor(theme.fg, theme.bg);
+
+    while (true) {
+        char line[80];
+        sprintf(line, "pingmon %s  %dms  round %lu", running ? "running" : "stopped",
+                interval, (unsigned long)rounds);
+        viewLine(0, line);
+        viewLine(CONSOLE_CHAR_H * 2, PINGMON_HEADER);
+
+        int y = CONSOLE_CHAR_H * 3 + 2;
+        for (int i = 0; i < hostCount; i++) {
+            PingHost h;
+            xSemaphoreTake(monMutex, portMAX_DELAY);
+            h = hosts[i];
+            xSemaphoreGive(monMutex);
+
+            PingStats s;
+            computeStats(h, s);
+            hostLine(line, h, s);
+            viewLine(y, line);
+            drawSparkline(y + CONSOLE_CHAR_H + 1, h, max(s.maxMs, 10));
+            y += CONSOLE_CHAR_H + SPARK_H + 6;
+        }
+
+        viewLine(STATUS_Y, "Press ENTER to exit");
+
+        TtyLine input;
+        if (ttyReadLine(input, pdMS_TO_TICKS(PINGMON_REFRESH_MS))) {
+            screenLocked = false;
+            consoleRedraw();
+            return;
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #include "pug.h"
 #include "display.h"
 #include "config.h"
+#include "tty.h"
 
 
 static const uint16_t pug[] PROGMEM  = {
@@ -246,41 +247,37 @@ static const uint16_t pug[] PROGMEM  = {
   0x2227, 0x330b, 0x2aa9, 0x22c9, 0x22a8, 0x22e9, 0x09c5, 0x1a06, 0x2288, 0x11a5, 0x1a68, 0x11e5, 0x0102, 0x19a5, 0x32eb, 0x1a88, 0x440f, 0x19e6, 0x11e6, 0x11e6, 0x1144, 0x0904, 0x0985, 0x238c, 0x2c0e, 0x22ca, 0x1a27, 0x19e6, 0x338c, 0x19e6, 0x4c0e, 0x1ac9, 0x3c2e, 0x0924, 0x2bad, 0x11a5, 0x11c5, 0x19c5, 0x1164, 0x0964, 0x0984, 0x0964, 0x00e2, 0x08a2, 0x0944, 0x2aea, 0x1309, 0x1b0a, 0x1247, 0x22ea, 0x1268, 0x12a9, 0x1b0a, 0x12c9, 0x22ea, 0x22c9, 0x1aca, 0x336c, 0x09a5, 0x3c30, 0x1a28, 0x2249, 0x3b6d, 0x238b, 0x2b0a, 0x22a8, 0x2b0b, 0x3b4b, 0x1a06, 0x11a5, 0x238d, 0x3c4f, 0x12a9, 0x1a68, 0x1b4b, 0x130b, 0x3450, 0x33ce, 0x2b4a, 0x12e9, 0x12c8, 0x12c9, 0x13cc, 0x134b, 0x3bee, 0x33f0, 0x23ae, 0x4c71, 0x244f, 0x2c2e, 0x1b0a, 0x232a, 0x1165, 0x1185, 0x1aa9, 0x23ad, 0x2b4b, 0x1267, 0x232a, 0x130a, 0x1a07, 0x08e3, 0x1b6b, 0x1a07, 0x0984, 0x1a67, 0x236a, 0x130a, 0x1cb1, 0x2513, 0x34f2, 0x32c9, 0x2b2b, 0x2b8c, 0x09a5, 0x1268, 0x1aea, 0x234b, 0x346f, 0x338b, 0x1227, 0x1228, 0x2bad, 0x230a, 0x2bcd, 0x19e6, 0x2a67, 0x2aea, 0x336b, 0x2ae9, 0x230a, 0x4c2e, 0x23ac, 0x12a8, 0x0924, 0x23ac, 0x22a8, 0x2c2e, 0x1b6b, 0x2b8c, 0x1b6b, 0x340e, 0x440e, 0x0ae9, 0x0a06, 0x0a47, 0x0aa8, 0x0288, 0x0288, 0x1288, 0x1267, 0x338b, 0x44b0, 0x232a, 0x1b4b, 0x1288, 0x2b8c, 0x09c5, 0x12c9, 0x23cc, 0x0a47, 0x23cc, 0x2bec, 0x234b, 0x2bac, 0x2bed, 0x6513, 0x440f, 0x5491, 0x5c50, 0x11e5, 0x0247, 0x0ac9, 0x12e9, 0x0b09, 0x0a06, 0x132a, 0x5c2f, 0x33cd, 0x2b2b, 0x3c2f, 0x1aa8, 0x1a89, 0x53cf, 0x5c50, 0x7cf4, 0x6472, 0x332b, 0x23ad, 0x64d2, 0x134a, 0x43ee, 0x4c10, 0x74f5, 0x4c30, 0x3bcd, 0x2c0e, 0x4471, 0x0b0a, 0x0a26, 0x330a, 0x13ac, 0x1b6c, 0x132a, 0x2bed, 0x44d2, 0x236d, 0x2b8c, 0x336c, 0x3c0d, 0x3bcc, 0x7511, 0x12a8, 0x1a88, 0x336c, 0x2c0e, 0x0b09, 0x0ac9, 0x0a88, 0x1b09, 0x3c0e, 0x1aa9, 0x1b4a, 0x12e9, 0x1b0a, 0x0267, 0x0267, 0x132a, 0x232b, 0x2aea, 0x1aa8, 0x2aa9, 0x2a68, 0x22a9, 0x334b, 0x33ac, 0x9e38, 0x4490, 0x3c0e, 0x2bed, 0x33cc, 0x232a, 0x2b4c, 0x338b, 0x3bab, 0x1a88, 0x1aa8, 0x2329, 0x1247, 0x230a, 0x234a, 0x1b2a, 0x2b6c, 0x12a9, 0x0a27, 0x12c8, 0x12a8, 0x12c8, 0x1b4a, 0x132a, 0x3bcd, 0x12a8, 0x0aa9, 0x0a47, 0x12c9, 0x1b2b, 0x1a67, 0x0a47, 0x1288, 0x1b6b, 0x1227, 0x1ac9, 0x338c, 0x33cc, 0x444e, 0x338b, 0x22a9, 0x2329, 0x1ac9, 0x3c2e, 0x1b09, 0x22ea, 0x332b, 0x3b6b, 0x2b2b, 0x2b4b, 0x3b8c, 0x2b0a, 0x232a, 0x1ae9, 0x1267, 0x12c8, 0x1b29, 0x12e9, 0x1206, 0x1287, 0x338b, 0x1287, 0x3c0e, 0x3bad, 0x33ee, 0x2a47, 0x0123, 0x1a88, 0x334b, 0x2a68, 0x3288, 0x2227, 0x22c9, 0x1bac, 0x1bab, 0x2b4a, 0x22e9, 0x2b6b, 0x446f, 0x44b0, 0x5552, 0x5511, 0x3c8f, 0x2c0d
 };
 void displayPug() {
-   screenLocked = true;
-    tft.fillScreen(ST77XX_BLACK);
+    screenLocked = true;
 
-    tft.startWrite();
-    tft.setAddrWindow(0, 0, 320, 240);
-
-    static uint16_t line[320]; 
-
-    for (int y = 0; y < 240; y++) {
-        for (int x = 0; x < 320; x++) {
-            uint16_t c = pgm_read_word(&pug[y * 320 + x]);
-
-            line[x] = c;
+    if (tft.bandMaxPixels() > 0) {
+        // The image lives in flash, which SPI DMA cannot read, so it is copied
+        // band by band into the display's buffers while earlier bands transfer.
+        for (int y0 = 0; y0 < 240; y0 += BAND_ROWS) {
+            uint16_t* band = tft.getBandBuffer();
+            memcpy_P(band, &pug[y0 * 320], 320 * BAND_ROWS * sizeof(uint16_t));
+            tft.pushBand(0, y0, 320, BAND_ROWS, band);
         }
-
-        tft.writePixels(line, 320);
+        tft.waitIdle();
+    } else {
+        // No pipeline: one line at a time, as before
+        static uint16_t line[320];
+        tft.startWrite();
+        tft.setAddrWindow(0, 0, 320, 240);
+        for (int y = 0; y < 240; y++) {
+            memcpy_P(line, &pug[y * 320], sizeof(line));
+            tft.writePixels(line, 320);
+        }
+        tft.endWrite();
     }
 
-    tft.endWrite();
     tft.setTextColor(ST77XX_WHITE, ST77XX_BLACK);
     tft.setTextSize(1);
     tft.setCursor(5, 230);
     tft.print("Press ENTER to exit...");
     Serial.println("Press ENTER to exit...");
-    while (true) {
-        if (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n'){
-                applyTheme();
-                break;}
-        }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-    }
+    TtyLine line;
+    ttyReadLine(line, portMAX_DELAY);
 
-    screenLocked = false;      
-    clearScreen();
-    tft.print("> ");
+    screenLocked = false;
+    applyTheme();
 }
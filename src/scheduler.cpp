@@ -0,0 +1,613 @@
+#include "scheduler.h"
+#include "vfs.h"
+#include "fscache.h"
+#include "logchan.h"
+#include "display.h"
+#include "kernel.h"
+#include "tty.h"
+#include "console.h"
+#include <time.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+#include <esp_timer.h>
+
+// Alarms, countdown timers and cron entries share one hierarchical timer
+// wheel counted in whole seconds. Level 0 has a slot per second for the
+// next 64 s, each higher level covers 64 times the span of the one below,
+// and an entry moves down a level whenever the wheel wraps past it, so
+// insert, cancel and expiry are all constant time however many entries
+// there are.
+//
+// A single one-shot FreeRTOS timer is set for the next second that needs
+// work: the next occupied level-0 slot or, while higher levels hold
+// entries, the next cascade. Only a running countdown timer, shown on the
+// status bar, makes it tick every second. The timer callback just wakes
+// the "timerd" process, which advances the wheel and acts on whatever
+// expired: alarms and
+// timers print, and cron entries queue their command on the tty as if it
+// had been typed, so they run on the shell like anything else. Alarms and
+// cron entries are saved to SCHED_FILE.
+
+#define SLOTS (1 << SCHED_WHEEL_BITS)
+#define SLOT_MASK (SLOTS - 1)
+
+#define NOTIFY_TICK  0x01
+#define NOTIFY_CLOCK 0x02
+
+#define TIME_VALID(t) ((t) > 100000)
+
+struct SchedEntry {
+    SchedEntry* next;
+    SchedEntry* prev;
+    uint32_t expires;          // wheel second at which it fires
+    int id;                    // 0 = free
+    SchedKind kind;
+    uint32_t period;           // SCHED_TIMER: duration, SCHED_CRON_EVERY: interval
+    uint8_t hour;
+    uint8_t minute;
+    bool queued;               // in a wheel slot
+    uint8_t level;
+    uint8_t slot;
+    char text[SCHED_TEXT_MAX]; // alarm message or cron command
+};
+
+static SchedEntry entries[SCHED_MAX_ENTRIES];
+static SchedEntry* wheel[SCHED_WHEEL_LEVELS][SLOTS];
+static uint32_t wheelNow = 0;        // last second the wheel has processed
+static int queuedCount = 0;
+static int nextId = 1;
+
+static SemaphoreHandle_t schedMutex = NULL;
+static TimerHandle_t tickTimer = NULL;
+static TaskHandle_t timerdTask = NULL;
+
+static uint32_t currentSecond() {
+    return (uint32_t)(esp_timer_get_time() / 1000000LL);
+}
+
+static void unlink(SchedEntry* e) {
+    if (!e->queued) return;
+    if (e->prev) e->prev->next = e->next;
+    else wheel[e->level][e->slot] = e->next;
+    if (e->next) e->next->prev = e->prev;
+    e->next = e->prev = NULL;
+    e->queued = false;
+    if (--queuedCount == 0) xTimerStop(tickTimer, 0);
+}
+
+// Puts an entry in the slot its remaining time belongs to.
+static void place(SchedEntry* e) {
+    uint32_t delta = e->expires - wheelNow;
+    const uint32_t maxDelta = (1u << (SCHED_WHEEL_BITS * SCHED_WHEEL_LEVELS)) - 1;
+    if ((int32_t)delta < 0) {
+        // Only while cascading: the slot for wheelNow is expired right after.
+        delta = 0;
+        e->expires = wheelNow;
+    } else if (delta > maxDelta) {
+        delta = maxDelta;
+        e->expires = wheelNow + maxDelta;
+    }
+
+    int level = 0;
+    while (level < SCHED_WHEEL_LEVELS - 1 &&
+           delta >= (1u << (SCHED_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    e->level = level;
+    e->slot = (e->expires >> (SCHED_WHEEL_BITS * level)) & SLOT_MASK;
+
+    e->prev = NULL;
+    e->next = wheel[e->level][e->slot];
+    if (e->next) e->next->prev = e;
+    wheel[e->level][e->slot] = e;
+}
+
+static bool higherLevelsEmpty() {
+    for (int level = 1; level < SCHED_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < SLOTS; slot++) {
+            if (wheel[level][slot]) return false;
+        }
+    }
+    return true;
+}
+
+static bool timerQueued() {
+    for (int i = 0; i < SCHED_MAX_ENTRIES; i++) {
+        if (entries[i].id && entries[i].kind == SCHED_TIMER && entries[i].queued) return true;
+    }
+    return false;
+}
+
+// Caller holds schedMutex. Sets tickTimer for the next second the wheel
+// has to be advanced to.
+static void rearm() {
+    if (queuedCount == 0) {
+        xTimerStop(tickTimer, 0);
+        return;
+    }
+
+    uint32_t steps = SLOTS;
+    if (timerQueued()) {
+        steps = 1;
+    } else {
+        bool cascades = !higherLevelsEmpty();
+        for (uint32_t k = 1; k <= SLOTS; k++) {
+            int slot = (wheelNow + k) & SLOT_MASK;
+            if (wheel[0][slot] || (slot == 0 && cascades)) {
+                steps = k;
+                break;
+            }
+        }
+    }
+
+    int64_t waitUs = (int64_t)(wheelNow + steps) * 1000000LL - esp_timer_get_time();
+    TickType_t ticks = waitUs > 0 ? pdMS_TO_TICKS(waitUs / 1000 + 1) : 1;
+    if (ticks == 0) ticks = 1;
+    xTimerChangePeriod(tickTimer, ticks, 0);
+}
+
+static void link(SchedEntry* e) {
+    if (queuedCount == 0) {
+        // Nothing is waiting, so the wheel can jump to the present instead
+        // of replaying the idle seconds.
+        uint32_t now = currentSecond();
+        if ((int32_t)(now - wheelNow) > 0) wheelNow = now;
+    }
+    place(e);
+    e->queued = true;
+    queuedCount++;
+    rearm();
+}
+
+// Moves every entry in one slot of a higher level down to where its
+// remaining time now belongs. Returns the slot index.
+static int cascade(int level) {
+    int slot = (wheelNow >> (SCHED_WHEEL_BITS * level)) & SLOT_MASK;
+    SchedEntry* e = wheel[level][slot];
+    wheel[level][slot] = NULL;
+    while (e) {
+        SchedEntry* next = e->next;
+        place(e);
+        e = next;
+    }
+    return slot;
+}
+
+// Advances one second and moves what expired onto the fired list.
+static SchedEntry* advance() {
+    wheelNow++;
+    int slot = wheelNow & SLOT_MASK;
+    if (slot == 0) {
+        for (int level = 1; level < SCHED_WHEEL_LEVELS; level++) {
+            if (cascade(level) != 0) break;
+        }
+    }
+
+    SchedEntry* fired = NULL;
+    SchedEntry* e = wheel[0][slot];
+    while (e) {
+        SchedEntry* next = e->next;
+        if ((int32_t)(e->expires - wheelNow) <= 0) {
+            unlink(e);
+            e->next = fired;
+            fired = e;
+        }
+        e = next;
+    }
+    return fired;
+}
+
+// Seconds from now until the next local HH:MM at least minWait seconds
+// away, or 0 if the clock is not set yet.
+static uint32_t secondsUntil(int hour, int minute, int minWait) {
+    time_t now = time(nullptr);
+    if (!TIME_VALID(now)) return 0;
+
+    struct tm t;
+    localtime_r(&now, &t);
+    int nowSec = t.tm_hour * 3600 + t.tm_min * 60 + t.tm_sec;
+    int target = hour * 3600 + minute * 60;
+    int wait = target - nowSec;
+    if (wait < minWait) wait += 86400;
+    return wait;
+}
+
+// Caller holds schedMutex. Wall-clock entries wait unqueued until the
+// clock is set. After a daily entry fires, the wheel and the slewed wall
+// clock can disagree by a few seconds, so refire skips the current minute.
+static void schedule(SchedEntry* e, bool refire = false) {
+    unlink(e);
+    uint32_t delay;
+    switch (e->kind) {
+        case SCHED_ALARM:
+        case SCHED_CRON_DAILY:
+            delay = secondsUntil(e->hour, e->minute, refire ? 60 : 1);
+            if (delay == 0) return;
+            break;
+        default:
+            delay = e->period;
+            break;
+    }
+    e->expires = currentSecond() + delay;
+    link(e);
+}
+
+static SchedEntry* allocEntry(SchedKind kind) {
+    for (int i = 0; i < SCHED_MAX_ENTRIES; i++) {
+        if (entries[i].id == 0) {
+            SchedEntry* e = &entries[i];
+            memset(e, 0, sizeof(*e));
+            e->id = nextId++;
+            e->kind = kind;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void freeEntry(SchedEntry* e) {
+    unlink(e);
+    e->id = 0;
+}
+
+// Caller holds schedMutex.
+static void saveEntries() {
+    File f = vfs().open(SCHED_FILE, FILE_WRITE);
+    if (!f) return;
+    for (int i = 0; i < SCHED_MAX_ENTRIES; i++) {
+        SchedEntry& e = entries[i];
+        if (e.id == 0) continue;
+        switch (e.kind) {
+            case SCHED_ALARM:
+                f.printf("alarm %02d:%02d %s\n", e.hour, e.minute, e.text);
+                break;
+            case SCHED_CRON_DAILY:
+                f.printf("cron %02d:%02d %s\n", e.hour, e.minute, e.text);
+                break;
+            case SCHED_CRON_EVERY:
+                f.printf("cron %lus %s\n", (unsigned long)e.period, e.text);
+                break;
+            default:
+                break;
+        }
+    }
+    f.close();
+    fsCacheUpdate(SCHED_FILE);
+}
+
+static bool parseClock(const char* s, int& hour, int& minute) {
+    char extra;
+    if (sscanf(s, "%d:%d%c", &hour, &minute, &extra) != 2) return false;
+    return hour >= 0 && hour <= 23 && minute >= 0 && minute <= 59;
+}
+
+// "30s", "5m", "2h" or a bare number of seconds.
+static uint32_t parseDuration(const char* s) {
+    char* end;
+    unsigned long n = strtoul(s, &end, 10);
+    if (end == s) return 0;
+    if (*end == 'm') n *= 60;
+    else if (*end == 'h') n *= 3600;
+    else if (*end != 's' && *end != '\0') return 0;
+    if (*end && end[1]) return 0;
+    return n;
+}
+
+static int schedLog = -1;
+
+// Appends to SCHED_LOG through a buffered log channel, so a busy cron
+// entry does not cost a flash metadata update every time it runs.
+static void logFired(const SchedEntry* e) {
+    static const char* kindNames[] = {"alarm", "timer", "cron", "cron"};
+    char stamp[24];
+    time_t now = time(nullptr);
+    if (TIME_VALID(now)) {
+        struct tm t;
+        localtime_r(&now, &t);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &t);
+    } else {
+        sprintf(stamp, "+%lus", (unsigned long)(millis() / 1000));
+    }
+
+    char line[SCHED_TEXT_MAX + 48];
+    snprintf(line, sizeof(line), "%s %s #%d %s", stamp, kindNames[e->kind], e->id, e->text);
+    logLine(schedLog, line);
+}
+
+static void fire(SchedEntry* e) {
+    char line[80];
+    logFired(e);
+    switch (e->kind) {
+        case SCHED_ALARM:
+            printLine("");
+            printLine("*** ALARM! ***");
+            if (e->text[0]) printLine(e->text);
+            printLine("*** ALARM! ***");
+            printLine("");
+            break;
+
+        case SCHED_TIMER:
+            sprintf(line, "Timer #%d finished! (%lus)", e->id, (unsigned long)e->period);
+            printLine(line);
+            for (int i = 0; i < 3; i++) printLine("BEEP!");
+            break;
+
+        default:
+            // Wait for full-screen programs to give the shell back; they
+            // read the same tty queue.
+            while (screenLocked) vTaskDelay(200 / portTICK_PERIOD_MS);
+            if (!ttyInject(e->text)) {
+                Serial.printf("[CRON] tty queue full, skipped: %s\n", e->text);
+            }
+            break;
+    }
+}
+
+// Puts the countdown of the timer due soonest on the status bar.
+static void showTimers() {
+    xSemaphoreTake(schedMutex, portMAX_DELAY);
+    uint32_t now = currentSecond();
+    SchedEntry* soonest = NULL;
+    int count = 0;
+    for (int i = 0; i < SCHED_MAX_ENTRIES; i++) {
+        SchedEntry& e = entries[i];
+        if (e.id == 0 || e.kind != SCHED_TIMER || !e.queued) continue;
+        if (soonest == NULL || (int32_t)(e.expires - soonest->expires) < 0) soonest = &e;
+        count++;
+    }
+
+    char status[STATUS_FIELD_COLS] = "";
+    if (soonest) {
+        int32_t left = soonest->expires - now;
+        if (left < 0) left = 0;
+        snprintf(status, sizeof(status), "T#%d %ld:%02ld:%02ld%s", soonest->id,
+                 (long)(left / 3600), (long)(left / 60 % 60), (long)(left % 60),
+                 count > 1 ? " +" : "");
+    }
+    xSemaphoreGive(schedMutex);
+
+    consoleStatus(STATUS_TIMER, status);
+}
+
+static void timerdProcess(void* parameter) {
+    timerdTask = xTaskGetCurrentTaskHandle();
+
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, 0xFFFFFFFF, &bits, portMAX_DELAY);
+
+        if (bits & NOTIFY_CLOCK) {
+            xSemaphoreTake(schedMutex, portMAX_DELAY);
+            for (int i = 0; i < SCHED_MAX_ENTRIES; i++) {
+                SchedEntry& e = entries[i];
+                if (e.id && (e.kind == SCHED_ALARM || e.kind == SCHED_CRON_DAILY)) {
+                    schedule(&e);
+                }
+            }
+            xSemaphoreGive(schedMutex);
+        }
+
+        uint32_t now = currentSecond();
+        while (true) {
+            xSemaphoreTake(schedMutex, portMAX_DELAY);
+            if (queuedCount == 0 || (int32_t)(now - wheelNow) <= 0) {
+                xSemaphoreGive(schedMutex);
+                break;
+            }
+            SchedEntry* fired = advance();
+
+            // Copy out what to run so the mutex is not held while printing
+            // or waiting on the tty.
+            static SchedEntry run[SCHED_MAX_ENTRIES];
+            int count = 0;
+            bool changed = false;
+            while (fired) {
+                SchedEntry* next = fired->next;
+                run[count++] = *fired;
+                if (fired->kind == SCHED_CRON_EVERY || fired->kind == SCHED_CRON_DAILY) {
+                    schedule(fired, true);
+                } else {
+                    changed |= fired->kind == SCHED_ALARM;
+                    fired->id = 0;
+                }
+                fired = next;
+            }
+            if (changed) saveEntries();
+            xSemaphoreGive(schedMutex);
+
+            for (int i = 0; i < count; i++) fire(&run[i]);
+        }
+
+        xSemaphoreTake(schedMutex, portMAX_DELAY);
+        rearm();
+        xSemaphoreGive(schedMutex);
+        showTimers();
+    }
+}
+
+static void tickCallback(TimerHandle_t timer) {
+    if (timerdTask) xTaskNotify(timerdTask, NOTIFY_TICK, eSetBits);
+}
+
+// Call after the time service has set or stepped the clock; wall-clock
+// entries are placed again. Safe from any task.
+void schedulerClockChanged() {
+    if (timerdTask) xTaskNotify(timerdTask, NOTIFY_CLOCK, eSetBits);
+}
+
+// spec is HH:MM (daily) or a duration such as 30s, 5m or 2h (repeating).
+// Caller holds schedMutex.
+static SchedEntry* makeCron(const char* spec, const char* command) {
+    int hour = 0, minute = 0;
+    uint32_t period = 0;
+    bool daily = parseClock(spec, hour, minute);
+    if (!daily && (period = parseDuration(spec)) == 0) return NULL;
+
+    SchedEntry* e = allocEntry(daily ? SCHED_CRON_DAILY : SCHED_CRON_EVERY);
+    if (e == NULL) return NULL;
+    e->hour = hour;
+    e->minute = minute;
+    e->period = period;
+    strlcpy(e->text, command, sizeof(e->text));
+    schedule(e);
+    return e;
+}
+
+static void loadEntries() {
+    File f = vfs().open(SCHED_FILE, FILE_READ);
+    if (!f) return;
+
+    char buf[SCHED_TEXT_MAX + 24];
+    while (f.available()) {
+        int n = f.readBytesUntil('\n', buf, sizeof(buf) - 1);
+        buf[n] = '\0';
+
+        char* kind = strtok(buf, " ");
+        char* spec = strtok(NULL, " ");
+        char* text = strtok(NULL, "");
+        if (!kind || !spec) continue;
+        if (!text) text = (char*)"";
+
+        int hour, minute;
+        if (strcmp(kind, "alarm") == 0 && parseClock(spec, hour, minute)) {
+            SchedEntry* e = allocEntry(SCHED_ALARM);
+            if (!e) break;
+            e->hour = hour;
+            e->minute = minute;
+            strlcpy(e->text, text, sizeof(e->text));
+            schedule(e);
+        } else if (strcmp(kind, "cron") == 0 && text[0]) {
+            makeCron(spec, text);
+        }
+    }
+    f.close();
+}
+
+// Call from setup(), before the shell can add entries.
+void schedulerInit() {
+    schedMutex = xSemaphoreCreateMutex();
+    tickTimer = xTimerCreate("schedtick", pdMS_TO_TICKS(SCHED_TICK_MS), pdFALSE, NULL,
+                             tickCallback);
+    wheelNow = currentSecond();
+
+    createProcess(timerdProcess, "timerd", SCHED_STACK, 2);
+}
+
+// Restores saved alarms and cron entries; needs the filesystem mounted.
+void schedulerLoad() {
+    schedLog = logOpen(SCHED_LOG);
+
+    xSemaphoreTake(schedMutex, portMAX_DELAY);
+    loadEntries();
+    xSemaphoreGive(schedMutex);
+}
+
+static String formatClock(int hour, int minute) {
+    char buf[6];
+    sprintf(buf, "%02d:%02d", hour, minute);
+    return String(buf);
+}
+
+int addAlarm(int hour, int minute, const char* message) {
+    xSemaphoreTake(schedMutex, portMAX_DELAY);
+    SchedEntry* e = allocEntry(SCHED_ALARM);
+    if (e == NULL) {
+        xSemaphoreGive(schedMutex);
+        printLine("alarm: too many scheduled entries");
+        return -1;
+    }
+    e->hour = hour;
+    e->minute = minute;
+    strlcpy(e->text, message, sizeof(e->text));
+    schedule(e);
+    saveEntries();
+    int id = e->id;
+    bool waiting = !e->queued;
+    xSemaphoreGive(schedMutex);
+
+    printLine("Alarm #" + String(id) + " set for " + formatClock(hour, minute) +
+              (waiting ? " (waiting for time sync)" : ""));
+    return id;
+}
+
+int addTimer(uint32_t seconds) {
+    xSemaphoreTake(schedMutex, portMAX_DELAY);
+    SchedEntry* e = allocEntry(SCHED_TIMER);
+    if (e == NULL) {
+        xSemaphoreGive(schedMutex);
+        printLine("timer: too many scheduled entries");
+        return -1;
+    }
+    e->period = seconds;
+    schedule(e);
+    int id = e->id;
+    xSemaphoreGive(schedMutex);
+
+    showTimers();
+    printLine("Timer #" + String(id) + " started for " + String(seconds) + " seconds.");
+    return id;
+}
+
+int addCron(const char* spec, const char* command) {
+    xSemaphoreTake(schedMutex, portMAX_DELAY);
+    SchedEntry* e = makeCron(spec, command);
+    if (e) saveEntries();
+    int id = e ? e->id : -1;
+    xSemaphoreGive(schedMutex);
+
+    if (e == NULL) printLine("cron: bad spec or too many scheduled entries");
+    return id;
+}
+
+bool cancelEntry(int id) {
+    xSemaphoreTake(schedMutex, portMAX_DELAY);
+    for (int i = 0; i < SCHED_MAX_ENTRIES; i++) {
+        if (entries[i].id == id) {
+            bool persistent = entries[i].kind != SCHED_TIMER;
+            freeEntry(&entries[i]);
+            if (persistent) saveEntries();
+            xSemaphoreGive(schedMutex);
+            if (!persistent) showTimers();
+            return true;
+        }
+    }
+    xSemaphoreGive(schedMutex);
+    return false;
+}
+
+void listEntries(int kindMask) {
+    static const char* kindNames[] = {"alarm", "timer", "cron", "cron"};
+    char line[96];
+    int shown = 0;
+
+    xSemaphoreTake(schedMutex, portMAX_DELAY);
+    uint32_t now = currentSecond();
+    for (int i = 0; i < SCHED_MAX_ENTRIES; i++) {
+        SchedEntry& e = entries[i];
+        if (e.id == 0 || !(kindMask & SCHED_MASK(e.kind))) continue;
+
+        char when[16];
+        if (e.kind == SCHED_CRON_EVERY) {
+            sprintf(when, "every %lus", (unsigned long)e.period);
+        } else if (e.kind == SCHED_TIMER) {
+            sprintf(when, "%lus", (unsigned long)e.period);
+        } else {
+            sprintf(when, "%02d:%02d", e.hour, e.minute);
+        }
+
+        char left[16];
+        if (e.queued) {
+            sprintf(left, "in %lus", (unsigned long)(e.expires - now));
+        } else {
+            strcpy(left, "no clock");
+        }
+
+        snprintf(line, sizeof(line), "#%-3d %-5s %-11s %-10s %s", e.id, kindNames[e.kind],
+                 when, left, e.text);
+        printLine(line);
+        shown++;
+    }
+    xSemaphoreGive(schedMutex);
+
+    if (shown == 0) printLine("Nothing scheduled");
+}
@@ -0,0 +1,105 @@
+#include "timesync.h"
+#include "config.h"
+#include "scheduler.h"
+#include <WiFi.h>
+#include <sys/time.h>
+#include <esp_timer.h>
+#include <esp_sntp.h>
+#include <freertos/timers.h>
+
+// Background SNTP. The service starts when WiFi gets an address and lets
+// lwIP's SNTP client poll on its own schedule; each completed sync lands
+// in syncCallback. Comparing the NTP time between two syncs with the
+// monotonic esp_timer gives the local oscillator's drift, and a timer
+// nudges the clock by that rate with adjtime() so it stays close between
+// syncs.
+
+static portMUX_TYPE syncMux = portMUX_INITIALIZER_UNLOCKED;
+static TimeSyncStatus state;
+static int64_t lastNtpUs = 0;          // NTP time of the last sync, epoch us
+static int64_t lastMonoUs = 0;         // esp_timer at the last sync
+static TimerHandle_t trimTimer = NULL;
+
+static int64_t toMicros(const struct timeval* tv) {
+    return (int64_t)tv->tv_sec * 1000000LL + tv->tv_usec;
+}
+
+// Runs in the lwIP thread: no printing, no blocking.
+static void syncCallback(struct timeval* tv) {
+    int64_t mono = esp_timer_get_time();
+    int64_t ntp = toMicros(tv);
+
+    portENTER_CRITICAL(&syncMux);
+    if (state.syncs > 0) {
+        int64_t monoSpan = mono - lastMonoUs;
+        int64_t predicted = lastNtpUs + monoSpan + state.appliedUs;
+        state.lastOffsetUs = predicted - ntp;
+
+        if (monoSpan >= (int64_t)TIME_MIN_DRIFT_SPAN_MS * 1000) {
+            float ppm = (float)(ntp - lastNtpUs - monoSpan) * 1e6f / (float)monoSpan;
+            if (fabsf(ppm) < TIME_MAX_DRIFT_PPM) {
+                state.driftPpm = state.driftValid ? state.driftPpm * 0.75f + ppm * 0.25f : ppm;
+                state.driftValid = true;
+            }
+        }
+    }
+    lastNtpUs = ntp;
+    lastMonoUs = mono;
+    state.appliedUs = 0;
+    state.lastSyncMs = millis();
+    state.syncs++;
+    portEXIT_CRITICAL(&syncMux);
+
+    schedulerClockChanged();
+}
+
+static void trimCallback(TimerHandle_t timer) {
+    portENTER_CRITICAL(&syncMux);
+    bool valid = state.driftValid && state.syncs > 0;
+    int64_t delta = valid ? (int64_t)(state.driftPpm * TIME_TRIM_MS / 1000.0f) : 0;
+    if (delta != 0) state.appliedUs += delta;
+    portEXIT_CRITICAL(&syncMux);
+
+    if (delta != 0) {
+        struct timeval adj;
+        adj.tv_sec = delta / 1000000;
+        adj.tv_usec = delta % 1000000;
+        adjtime(&adj, NULL);
+    }
+}
+
+void timeSyncInit() {
+    memset(&state, 0, sizeof(state));
+    sntp_set_time_sync_notification_cb(syncCallback);
+    sntp_set_sync_interval(TIME_RESYNC_MS);
+
+    trimTimer = xTimerCreate("timetrim", pdMS_TO_TICKS(TIME_TRIM_MS), pdTRUE, NULL,
+                             trimCallback);
+    if (trimTimer) xTimerStart(trimTimer, 0);
+}
+
+// Safe to call from the WiFi event task. SNTP resolves the server name
+// itself on every poll, so a pool name keeps rotating between servers.
+void timeSyncStart() {
+    configTime(GMT_OFFSET, DAYLIGHT_OFFSET, NTP_SERVER);
+    state.running = true;
+}
+
+// Asks for an immediate sync without waiting for it.
+void timeSyncNow() {
+    if (!state.running) {
+        timeSyncStart();
+    } else {
+        sntp_restart();
+    }
+}
+
+void timeSyncStatus(TimeSyncStatus& out) {
+    portENTER_CRITICAL(&syncMux);
+    out = state;
+    portEXIT_CRITICAL(&syncMux);
+}
+
+bool timeIsSynced() {
+    return state.syncs > 0;
+}
@@ -6,14 +6,20 @@
 #include "config.h"
 #include "pug.h"
 #include "timeutils.h"
+#include "tty.h"
+#include "console.h"
+#include "timesync.h"
+#include "scheduler.h"
+#include "kernel.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <time.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
-Alarm systemAlarm = {false, 0, 0, ""};
-
+// Requests a sync from the background time service and returns at once;
+// "time -v" shows when it lands.
 void syncTime() {
     if (WiFi.status() != WL_CONNECTED) {
         printLine("WiFi not connected.");
@@ -21,30 +27,47 @@ void syncTime() {
         return;
     }
     
-    printLine("Syncing time...");
-    configTime(GMT_OFFSET, DAYLIGHT_OFFSET, NTP_SERVER);
+    timeSyncNow();
+    printLine("Time sync requested (see 'time -v')");
+}
+
+static String formatAge(uint32_t seconds) {
+    char buf[24];
+    if (seconds < 60) sprintf(buf, "%lus", (unsigned long)seconds);
+    else if (seconds < 3600) sprintf(buf, "%lum %lus", (unsigned long)(seconds / 60), (unsigned long)(seconds % 60));
+    else sprintf(buf, "%luh %lum", (unsigned long)(seconds / 3600), (unsigned long)(seconds % 3600 / 60));
+    return String(buf);
+}
+
+void showTimeVerbose() {
+    printLine(getTime());
     
-    int attempts = 0;
-    while (time(nullptr) < 100000 && attempts < 20) {
-        vTaskDelay(500 / portTICK_PERIOD_MS);  
-        Serial.print(".");
-        attempts++;
+    TimeSyncStatus st;
+    timeSyncStatus(st);
+    if (st.syncs == 0) {
+        printLine(st.running ? "Waiting for first NTP sync" : "Time service not started");
+        return;
     }
     
-    if (time(nullptr) > 100000) {
-        printLine("");
-        printLine("Time synced!");
-        printLine(getTime());
+    char line[80];
+    uint32_t age = (millis() - st.lastSyncMs) / 1000;
+    printLine("Last sync: " + formatAge(age) + " ago from " + String(NTP_SERVER) +
+              " (" + String(st.syncs) + " syncs)");
+    if (st.syncs > 1) {
+        sprintf(line, "Offset at last sync: %+.3f ms", st.lastOffsetUs / 1000.0f);
+        printLine(line);
+    }
+    if (st.driftValid) {
+        sprintf(line, "Drift: %+.2f ppm, %+.3f ms compensated since sync",
+                st.driftPpm, st.appliedUs / 1000.0f);
     } else {
-        printLine("");
-        printLine("Time sync failed.");
+        sprintf(line, "Drift: measuring (needs syncs %lus apart)",
+                (unsigned long)(TIME_MIN_DRIFT_SPAN_MS / 1000));
     }
+    printLine(line);
     
-    
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    while (Serial.available() > 0) {
-        Serial.read();
-    }
+    uint32_t interval = TIME_RESYNC_MS / 1000;
+    printLine("Next sync: in " + formatAge(age < interval ? interval - age : 0));
 }
 
 String getTime() {
@@ -120,94 +143,110 @@ void showCalendar() {
     }
 }
 
+// Runs in the background on the scheduler; "sched" lists it and
+// "cancel <id>" stops it.
 void timerCommand(int seconds) {
     if (seconds <= 0) {
         printLine("Invalid timer duration.");
         return;
     }
-    
-    printLine("Timer started for " + String(seconds) + " seconds.");
-    printLine("Press ENTER to cancel...");
-    
-    unsigned long startTime = millis();
-    unsigned long endTime = startTime + (seconds * 1000);
-    
-    while (millis() < endTime) {
-        if (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n') {
-                printLine("Timer cancelled.");
-                return;
-            }
-        }
-        
-        unsigned long remaining = (endTime - millis()) / 1000;
-        if (remaining != ((endTime - millis() - 1000) / 1000)) {
-            printLine(String(remaining) + " seconds remaining...");
-        }
-        
-        vTaskDelay(100 / portTICK_PERIOD_MS);  
+    addTimer(seconds);
+}
+
+// The stopwatch is a process that sleeps until the next whole second,
+// redraws its status bar field and sleeps again. lap and stop read the
+// start time directly, so they are exact to the millisecond.
+#define SW_NOTIFY_STOP 0x01
+
+static portMUX_TYPE swMux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t swTask = NULL;
+static volatile bool swRunning = false;
+static volatile bool swStop = false;
+static int64_t swStartUs = 0;
+static int64_t swLapUs = 0;
+static int swLaps = 0;
+
+static String formatElapsed(int64_t us, bool millis) {
+    char buf[24];
+    uint32_t ms = us / 1000;
+    uint32_t s = ms / 1000;
+    if (millis) {
+        sprintf(buf, "%lu:%02lu:%02lu.%03lu", (unsigned long)(s / 3600),
+                (unsigned long)(s / 60 % 60), (unsigned long)(s % 60), (unsigned long)(ms % 1000));
+    } else {
+        sprintf(buf, "%lu:%02lu:%02lu", (unsigned long)(s / 3600),
+                (unsigned long)(s / 60 % 60), (unsigned long)(s % 60));
     }
-    
-    printLine("Timer finished!");
-    for (int i = 0; i < 3; i++) {
-        printLine("BEEP!");
-        vTaskDelay(200 / portTICK_PERIOD_MS);  
+    return String(buf);
+}
+
+static void stopwatchProcess(void* parameter) {
+    swTask = xTaskGetCurrentTaskHandle();
+
+    while (!swStop) {
+        int64_t elapsed = esp_timer_get_time() - swStartUs;
+        consoleStatus(STATUS_STOPWATCH, ("SW " + formatElapsed(elapsed, false)).c_str());
+
+        uint32_t toNext = 1000 - (elapsed / 1000) % 1000;
+        uint32_t bits = 0;
+        if (xTaskNotifyWait(0, 0xFFFFFFFF, &bits, pdMS_TO_TICKS(toNext)) &&
+            (bits & SW_NOTIFY_STOP)) {
+            break;
+        }
     }
+
+    swTask = NULL;
+    consoleStatus(STATUS_STOPWATCH, "");
+    exitProcess();
 }
 
 void stopwatchCommand() {
-    printLine("Stopwatch started.");
-    printLine("Press ENTER to stop...");
-    Theme currenttheme = getCurrentTheme();
-    unsigned long startTime = millis();
-    unsigned long lastUpdate = 0;
-    String lastTime = "";
-    int16_t timeX = tft.getCursorX();
-    int16_t timeY = tft.getCursorY();
-    
-    while (true) {
-        if (Serial.available()) {
-            char c = Serial.read();
-            if (c == '\n') {
-                unsigned long elapsed = millis() - startTime;
-                unsigned long s = elapsed / 1000;
-                unsigned long ms = elapsed % 1000;
-                unsigned long h = s / 3600;
-                unsigned long m = (s % 3600) / 60;
-                unsigned long sec = s % 60;
-                printLine("");
-                printLine("Stopped at: " + String(h) + "h " + String(m) + "m " + 
-                          String(sec) + "s " + String(ms) + "ms");
-                        
-                return;
-            }
-        }
-        
-        unsigned long current = millis();
-        if (current - lastUpdate >= 1000) {
-            unsigned long elapsed = current - startTime;
-            unsigned long s = elapsed / 1000;
-            unsigned long h = s / 3600;
-            unsigned long m = (s % 3600) / 60;
-            unsigned long sec = s % 60;
-            
-            String currentTime = String(h) + "h " + String(m) + "m " + String(sec) + "s";
-            
-            if (currentTime != lastTime) {
-                tft.setCursor(timeX+5, timeY);
-                tft.setTextColor(currenttheme.bg);
-                tft.print(lastTime);
+    if (swRunning || swTask != NULL) {
+        printLine("Stopwatch already running ('lap' or 'stop')");
+        return;
+    }
 
-                tft.setCursor(timeX+5, timeY);
-                tft.setTextColor(currenttheme.fg);
-                tft.print(currentTime);
-                
-                lastTime = currentTime;
-            }
-            lastUpdate = current;
-        }
+    swStartUs = esp_timer_get_time();
+    swLapUs = swStartUs;
+    swLaps = 0;
+    swStop = false;
+    if (createProcess(stopwatchProcess, "stopwatch", 2048, 1) < 0) {
+        printLine("stopwatch: cannot start process");
+        return;
     }
+    swRunning = true;
+    printLine("Stopwatch started ('lap' or 'stop')");
+}
+
+void stopwatchLap() {
+    if (!swRunning) {
+        printLine("No stopwatch running");
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&swMux);
+    int64_t split = now - swLapUs;
+    swLapUs = now;
+    int lap = ++swLaps;
+    portEXIT_CRITICAL(&swMux);
+
+    printLine("Lap " + String(lap) + ": " + formatElapsed(split, true) +
+              "  total " + formatElapsed(now - swStartUs, true));
+}
+
+void stopwatchStop() {
+    if (!swRunning) {
+        printLine("No stopwatch running");
+        return;
+    }
+
+    int64_t elapsed = esp_timer_get_time() - swStartUs;
+    swRunning = false;
+    swStop = true;
+    TaskHandle_t task = swTask;
+    if (task) xTaskNotify(task, SW_NOTIFY_STOP, eSetBits);
+    printLine("Stopped at: " + formatElapsed(elapsed, true));
 }
 
 void setAlarm(String timeStr) {
@@ -240,34 +279,8 @@ void setAlarm(String timeStr) {
         return;
     }
     
-    systemAlarm.active = true;
-    systemAlarm.hour = hour;
-    systemAlarm.minute = minute;
-    systemAlarm.message = message;
-    
-    printLine("Alarm set for " + String(hour) + ":" + 
-             (minute < 10 ? "0" : "") + String(minute));
+    addAlarm(hour, minute, message.c_str());
     if (message.length() > 0) {
         printLine("Message: " + message);
     }
 }
-
-void checkAlarm() {
-    if (!systemAlarm.active) return;
-    
-    time_t now = time(nullptr);
-    if (now < 100000) return;
-    
-    struct tm* t = localtime(&now);
-    
-    if (t->tm_hour == systemAlarm.hour && t->tm_min == systemAlarm.minute) {
-        printLine("");
-        printLine("*** ALARM! ***");
-        if (systemAlarm.message.length() > 0) {
-            printLine(systemAlarm.message);
-        }
-        printLine("*** ALARM! ***");
-        printLine("");
-        systemAlarm.active = false;
-    }
-}
\ No newline at end of file
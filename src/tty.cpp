@@ -0,0 +1,157 @@
+#include "tty.h"
+#include "display.h"
+#include <freertos/queue.h>
+
+// Serial line discipline. The UART driver's event task calls ttyReceive()
+// whenever bytes arrive; it drains everything available in fixed chunks,
+// edits and echoes in place, and posts each finished line to lineQueue.
+// Nothing here allocates, and readers block on the queue instead of polling.
+
+static QueueHandle_t lineQueue = NULL;
+static TtyLine assembling;
+static bool lastWasCR = false;
+static volatile TtyEcho echoMode = TTY_ECHO_ON;
+
+static uint32_t statLines = 0;
+static uint32_t statBytes = 0;
+static uint32_t statOverruns = 0;
+static uint32_t burstStart = 0;
+static uint32_t burstLast = 0;
+static uint32_t burstLines = 0;
+static uint32_t burstBytes = 0;
+
+static void finishLine() {
+    assembling.text[assembling.length] = '\0';
+
+    uint32_t now = millis();
+    if (burstLines == 0 || now - burstLast > TTY_BURST_GAP_MS) {
+        burstStart = now;
+        burstLines = 0;
+        burstBytes = 0;
+    }
+    burstLast = now;
+    burstLines++;
+    burstBytes += assembling.length + 1;
+    statLines++;
+
+    // This runs in the UART event task: blocking here would let the driver's
+    // RX buffer overrun unseen. A line the shell has no room for within
+    // TTY_QUEUE_WAIT_MS is dropped and its characters counted as overruns.
+    if (xQueueSend(lineQueue, &assembling, pdMS_TO_TICKS(TTY_QUEUE_WAIT_MS)) != pdTRUE) {
+        statOverruns += assembling.length + 1;
+    }
+    assembling.length = 0;
+}
+
+static void ttyReceive() {
+    static uint8_t chunk[64];
+    static char echo[64 * 3];
+
+    while (true) {
+        int avail = Serial.available();
+        if (avail <= 0) break;
+
+        int n = Serial.read(chunk, avail < (int)sizeof(chunk) ? avail : sizeof(chunk));
+        if (n <= 0) break;
+        statBytes += n;
+
+        int e = 0;
+        for (int i = 0; i < n; i++) {
+            char c = chunk[i];
+
+            if (c == '\n' && lastWasCR) {
+                lastWasCR = false;
+                continue;
+            }
+            lastWasCR = (c == '\r');
+
+            if (c == '\n' || c == '\r') {
+                if (echoMode != TTY_ECHO_OFF) {
+                    echo[e++] = '\r';
+                    echo[e++] = '\n';
+                }
+                Serial.write((const uint8_t*)echo, e);
+                e = 0;
+                finishLine();
+            } else if (c == '\b' || c == 127) {
+                if (assembling.length > 0) {
+                    assembling.length--;
+                    if (echoMode != TTY_ECHO_OFF) {
+                        echo[e++] = '\b';
+                        echo[e++] = ' ';
+                        echo[e++] = '\b';
+                    }
+                }
+            } else if (assembling.length < TTY_LINE_MAX - 1) {
+                assembling.text[assembling.length++] = c;
+                if (echoMode == TTY_ECHO_ON) {
+                    echo[e++] = c;
+                } else if (echoMode == TTY_ECHO_MASK) {
+                    echo[e++] = '*';
+                }
+            } else {
+                statOverruns++;
+            }
+        }
+
+        if (e > 0) {
+            Serial.write((const uint8_t*)echo, e);
+        }
+    }
+}
+
+void ttyInit(unsigned long baud) {
+    lineQueue = xQueueCreate(TTY_QUEUE_DEPTH, sizeof(TtyLine));
+    assembling.length = 0;
+
+    Serial.setRxBufferSize(TTY_RX_BUFFER);
+    Serial.begin(baud);
+    Serial.onReceive(ttyReceive);
+}
+
+bool ttyReadLine(TtyLine& line, TickType_t timeout) {
+    return xQueueReceive(lineQueue, &line, timeout) == pdTRUE;
+}
+
+bool ttyEnterPressed() {
+    TtyLine line;
+    return ttyReadLine(line, 0);
+}
+
+void ttySetEcho(TtyEcho mode) {
+    echoMode = mode;
+}
+
+// Queues a line as if it had been typed. Does not block; false if the
+// queue is full.
+bool ttyInject(const char* text) {
+    TtyLine line;
+    strlcpy(line.text, text, sizeof(line.text));
+    line.length = strlen(line.text);
+    return xQueueSend(lineQueue, &line, 0) == pdTRUE;
+}
+
+void ttyFlush() {
+    xQueueReset(lineQueue);
+}
+
+void ttyShowStats() {
+    char line[80];
+
+    sprintf(line, "Lines: %lu  Bytes: %lu  Overruns: %lu",
+            (unsigned long)statLines, (unsigned long)statBytes,
+            (unsigned long)statOverruns);
+    printLine(line);
+
+    sprintf(line, "Queued: %u/%d", (unsigned)uxQueueMessagesWaiting(lineQueue),
+            TTY_QUEUE_DEPTH);
+    printLine(line);
+
+    uint32_t span = burstLast - burstStart;
+    if (burstLines > 1 && span > 0) {
+        sprintf(line, "Last burst: %lu lines in %lu ms (%.1f lines/s, %.1f KB/s)",
+                (unsigned long)burstLines, (unsigned long)span,
+                burstLines * 1000.0f / span, burstBytes / 1.024f / span);
+        printLine(line);
+    }
+}
@@ -0,0 +1,340 @@
+#include "vfs.h"
+#include "fscache.h"
+#include "logchan.h"
+#include "display.h"
+#include "tty.h"
+#include <SPIFFS.h>
+#include <LittleFS.h>
+
+// The rest of the system reaches the data partition through vfs(), the
+// fs::FS of whichever backend mounted, and resolves names with vfsPath().
+// LittleFS is tried first and SPIFFS second, so a partition written by an
+// older build keeps working as SPIFFS until "fsmigrate" converts it. Only
+// LittleFS has real directories; on SPIFFS the working directory stays "/".
+
+static VfsBackend backend = VFS_NONE;
+static String cwd = "/";
+
+static bool mountBackend(VfsBackend which, bool format) {
+    bool ok = which == VFS_LITTLEFS ? LittleFS.begin(format) : SPIFFS.begin(format);
+    if (ok) backend = which;
+    return ok;
+}
+
+bool vfsMount() {
+    if (mountBackend(VFS_LITTLEFS, false)) return true;
+    if (mountBackend(VFS_SPIFFS, false)) return true;
+
+    printLine("[FS] No filesystem found, formatting");
+    return mountBackend(VFS_FORMAT_BACKEND, true);
+}
+
+fs::FS& vfs() {
+    if (backend == VFS_LITTLEFS) return LittleFS;
+    return SPIFFS;
+}
+
+VfsBackend vfsBackend() {
+    return backend;
+}
+
+const char* vfsName() {
+    switch (backend) {
+        case VFS_LITTLEFS: return "LittleFS";
+        case VFS_SPIFFS:   return "SPIFFS";
+        default:           return "none";
+    }
+}
+
+bool vfsHasDirs() {
+    return backend == VFS_LITTLEFS;
+}
+
+size_t vfsTotalBytes() {
+    if (backend == VFS_LITTLEFS) return LittleFS.totalBytes();
+    if (backend == VFS_SPIFFS) return SPIFFS.totalBytes();
+    return 0;
+}
+
+size_t vfsUsedBytes() {
+    if (backend == VFS_LITTLEFS) return LittleFS.usedBytes();
+    if (backend == VFS_SPIFFS) return SPIFFS.usedBytes();
+    return 0;
+}
+
+// Absolute, normalised path for a name typed by the user: relative names
+// start at the working directory, and "." and ".." are folded away.
+String vfsPath(String name) {
+    String full = name.startsWith("/") ? name : cwd + "/" + name;
+    String out = "";
+
+    int start = 0;
+    while (start <= (int)full.length()) {
+        int slash = full.indexOf('/', start);
+        if (slash < 0) slash = full.length();
+        String part = full.substring(start, slash);
+        start = slash + 1;
+
+        if (part.length() == 0 || part == ".") continue;
+        if (part == "..") {
+            int last = out.lastIndexOf('/');
+            out = last > 0 ? out.substring(0, last) : "";
+            continue;
+        }
+        out += "/" + part;
+    }
+    return out.length() ? out : "/";
+}
+
+String vfsCwd() {
+    return cwd;
+}
+
+static bool isDirectory(const String& path) {
+    if (path == "/") return true;
+    File f = vfs().open(path);
+    bool dir = f && f.isDirectory();
+    if (f) f.close();
+    return dir;
+}
+
+bool vfsChdir(String path) {
+    String target = vfsPath(path);
+    if (target != "/" && (!vfsHasDirs() || !isDirectory(target))) return false;
+    cwd = target;
+    return true;
+}
+
+bool vfsMkdir(String path) {
+    String target = vfsPath(path);
+    if (!vfsHasDirs() || !vfs().mkdir(target)) return false;
+    fsCacheUpdate(target);
+    return true;
+}
+
+bool vfsRmdir(String path) {
+    String target = vfsPath(path);
+    if (!vfsHasDirs() || target == "/" || !isDirectory(target)) return false;
+    if (cwd == target || cwd.startsWith(target + "/")) return false;
+    if (!vfs().rmdir(target)) return false;
+    fsCacheRemove(target);
+    return true;
+}
+
+// One file held in RAM while the partition is reformatted
+struct StagedFile {
+    StagedFile* next;
+    size_t size;
+    char path[64];
+    uint8_t data[];
+};
+
+static void freeStaged(StagedFile* list) {
+    while (list) {
+        StagedFile* next = list->next;
+        free(list);
+        list = next;
+    }
+}
+
+// Number and total size of the SPIFFS files, to check they fit in RAM
+// before asking.
+static void measureFiles(int& count, size_t& bytes) {
+    count = 0;
+    bytes = 0;
+    File root = SPIFFS.open("/");
+    while (File f = root.openNextFile()) {
+        count++;
+        bytes += f.size();
+        f.close();
+    }
+    root.close();
+}
+
+// Reads every SPIFFS file into RAM. NULL with ok=false when they do not
+// all fit with VFS_MIGRATE_RESERVE to spare.
+static StagedFile* stageFiles(int& count, size_t& bytes, bool& ok) {
+    StagedFile* list = NULL;
+    count = 0;
+    bytes = 0;
+    ok = true;
+
+    File root = SPIFFS.open("/");
+    while (ok) {
+        File f = root.openNextFile();
+        if (!f) break;
+
+        size_t size = f.size();
+        String path = f.path();
+        if (path.length() >= sizeof(list->path) ||
+            ESP.getFreeHeap() < size + sizeof(StagedFile) + VFS_MIGRATE_RESERVE) {
+            ok = false;
+        } else {
+            StagedFile* staged = (StagedFile*)malloc(sizeof(StagedFile) + size);
+            if (staged == NULL || f.read(staged->data, size) != size) {
+                free(staged);
+                ok = false;
+            } else {
+                staged->size = size;
+                strlcpy(staged->path, path.c_str(), sizeof(staged->path));
+                staged->next = list;
+                list = staged;
+                count++;
+                bytes += size;
+            }
+        }
+        f.close();
+    }
+    root.close();
+
+    if (!ok) {
+        freeStaged(list);
+        return NULL;
+    }
+    return list;
+}
+
+// Converts a SPIFFS partition to LittleFS in place. The files are held in
+// RAM while the partition is reformatted, so they must fit in the heap.
+// Files other processes have open are copied as they are on flash; log
+// channels are synced and held until the new filesystem is mounted.
+void vfsMigrate() {
+    if (backend != VFS_SPIFFS) {
+        printLine("fsmigrate: already on " + String(vfsName()));
+        return;
+    }
+
+    int count;
+    size_t bytes;
+    measureFiles(count, bytes);
+    if (ESP.getFreeHeap() < bytes + count * sizeof(StagedFile) + VFS_MIGRATE_RESERVE) {
+        printLine("fsmigrate: files do not fit in RAM (" + String(ESP.getFreeHeap()) +
+                  " bytes free), nothing changed");
+        return;
+    }
+
+    printLine(String(count) + " files, " + String(bytes) + " bytes to migrate.");
+    printLine("Type YES to format the partition as LittleFS:");
+    TtyLine answer;
+    ttyReadLine(answer, portMAX_DELAY);
+    if (strcmp(answer.text, "YES") != 0) {
+        printLine("fsmigrate: cancelled, nothing changed");
+        return;
+    }
+
+    // From here until the new filesystem is mounted no channel may reopen
+    // a SPIFFS file, so what is staged is what was on flash at the end.
+    logSuspend();
+    bool ok;
+    StagedFile* staged = stageFiles(count, bytes, ok);
+    if (!ok) {
+        logResume();
+        printLine("fsmigrate: files do not fit in RAM (" + String(ESP.getFreeHeap()) +
+                  " bytes free), nothing changed");
+        return;
+    }
+
+    SPIFFS.end();
+    backend = VFS_NONE;
+    if (!mountBackend(VFS_LITTLEFS, true)) {
+        printLine("fsmigrate: LittleFS format failed, restoring SPIFFS");
+        if (!mountBackend(VFS_SPIFFS, true)) {
+            logResume();
+            printLine("fsmigrate: SPIFFS remount failed, files lost");
+            freeStaged(staged);
+            return;
+        }
+    }
+    cwd = "/";
+    fsCacheInvalidate();
+
+    int written = 0;
+    for (StagedFile* f = staged; f; f = f->next) {
+        File out = vfs().open(f->path, FILE_WRITE, true);
+        if (out && out.write(f->data, f->size) == f->size) written++;
+        else printLine("fsmigrate: could not write " + String(f->path));
+        if (out) out.close();
+    }
+    logResume();
+    freeStaged(staged);
+
+    printLine("Migrated " + String(written) + "/" + String(count) + " files to " +
+              String(vfsName()) + ".");
+}
+
+// Times the basic operations on the mounted backend; run it before and
+// after fsmigrate to compare SPIFFS and LittleFS on the same partition.
+void vfsBench() {
+    uint8_t* buf = (uint8_t*)malloc(VFS_BENCH_SIZE);
+    if (buf == NULL) {
+        printLine("fsbench: out of memory");
+        return;
+    }
+    memset(buf, 'x', VFS_BENCH_SIZE);
+
+    char path[24];
+    uint32_t writeUs = 0, openUs = 0, readUs = 0, removeUs = 0;
+    int done = 0;
+
+    for (int i = 0; i < VFS_BENCH_FILES; i++) {
+        sprintf(path, "/.fsbench%d", i);
+        uint32_t t = micros();
+        File f = vfs().open(path, FILE_WRITE);
+        if (!f) break;
+        f.write(buf, VFS_BENCH_SIZE);
+        f.close();
+        writeUs += micros() - t;
+        done++;
+    }
+
+    for (int i = 0; i < done; i++) {
+        sprintf(path, "/.fsbench%d", i);
+        uint32_t t = micros();
+        File f = vfs().open(path, FILE_READ);
+        openUs += micros() - t;
+        t = micros();
+        f.read(buf, VFS_BENCH_SIZE);
+        f.close();
+        readUs += micros() - t;
+    }
+
+    uint32_t t = micros();
+    int entries = 0;
+    File root = vfs().open("/");
+    while (File f = root.openNextFile()) {
+        entries++;
+        f.close();
+    }
+    root.close();
+    uint32_t listUs = micros() - t;
+
+    for (int i = 0; i < done; i++) {
+        sprintf(path, "/.fsbench%d", i);
+        t = micros();
+        vfs().remove(path);
+        removeUs += micros() - t;
+    }
+    free(buf);
+    fsCacheInvalidate();
+
+    if (done == 0) {
+        printLine("fsbench: cannot create files");
+        return;
+    }
+
+    char line[80];
+    sprintf(line, "%s, %d files of %d bytes", vfsName(), done, VFS_BENCH_SIZE);
+    printLine(line);
+    sprintf(line, "write  %8.2f ms/file  %7.1f KB/s", writeUs / 1000.0f / done,
+            done * VFS_BENCH_SIZE * 1000.0f / 1024.0f / writeUs);
+    printLine(line);
+    sprintf(line, "open   %8.2f ms/file", openUs / 1000.0f / done);
+    printLine(line);
+    sprintf(line, "read   %8.2f ms/file  %7.1f KB/s", readUs / 1000.0f / done,
+            done * VFS_BENCH_SIZE * 1000.0f / 1024.0f / readUs);
+    printLine(line);
+    sprintf(line, "list   %8.2f ms for %d entries", listUs / 1000.0f, entries);
+    printLine(line);
+    sprintf(line, "remove %8.2f ms/file", removeUs / 1000.0f / done);
+    printLine(line);
+}
@@ -0,0 +1,104 @@
+#include "wifiprofiles.h"
+#include <Preferences.h>
+
+// Profiles are stored as one NVS blob. Saving an SSID that is already
+// known updates it in place; a new one replaces the least recently used
+// entry when the table is full.
+
+struct ProfileTable {
+    uint32_t stamp;
+    uint8_t count;
+    WifiProfile entries[WIFI_MAX_PROFILES];
+};
+
+static bool readTable(ProfileTable& table) {
+    memset(&table, 0, sizeof(table));
+
+    Preferences prefs;
+    if (!prefs.begin(WIFI_PREFS_NAMESPACE, true)) return false;
+    size_t len = prefs.getBytes("profiles", &table, sizeof(table));
+    prefs.end();
+
+    if (len != sizeof(table) || table.count > WIFI_MAX_PROFILES) {
+        memset(&table, 0, sizeof(table));
+        return false;
+    }
+    return true;
+}
+
+static bool writeTable(const ProfileTable& table) {
+    Preferences prefs;
+    if (!prefs.begin(WIFI_PREFS_NAMESPACE, false)) return false;
+    bool ok = prefs.putBytes("profiles", &table, sizeof(table)) == sizeof(table);
+    prefs.end();
+    return ok;
+}
+
+int loadProfiles(WifiProfile* out) {
+    ProfileTable table;
+    readTable(table);
+
+    int n = 0;
+    for (int i = 0; i < table.count; i++) {
+        int j = n++;
+        while (j > 0 && out[j - 1].lastUsed < table.entries[i].lastUsed) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = table.entries[i];
+    }
+    return n;
+}
+
+bool findProfile(const char* ssid, WifiProfile& out) {
+    ProfileTable table;
+    readTable(table);
+
+    for (int i = 0; i < table.count; i++) {
+        if (strcmp(table.entries[i].ssid, ssid) == 0) {
+            out = table.entries[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool saveProfile(const WifiProfile& profile) {
+    ProfileTable table;
+    readTable(table);
+
+    int slot = -1;
+    for (int i = 0; i < table.count; i++) {
+        if (strcmp(table.entries[i].ssid, profile.ssid) == 0) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0 && table.count < WIFI_MAX_PROFILES) {
+        slot = table.count++;
+    }
+    if (slot < 0) {
+        slot = 0;
+        for (int i = 1; i < table.count; i++) {
+            if (table.entries[i].lastUsed < table.entries[slot].lastUsed) slot = i;
+        }
+    }
+
+    table.entries[slot] = profile;
+    table.entries[slot].lastUsed = ++table.stamp;
+    return writeTable(table);
+}
+
+bool forgetProfile(const char* ssid) {
+    ProfileTable table;
+    readTable(table);
+
+    for (int i = 0; i < table.count; i++) {
+        if (strcmp(table.entries[i].ssid, ssid) == 0) {
+            table.entries[i] = table.entries[--table.count];
+            memset(&table.entries[table.count], 0, sizeof(WifiProfile));
+            return writeTable(table);
+        }
+    }
+    return false;
+}
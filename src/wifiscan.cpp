@@ -0,0 +1,237 @@
+#include "wifiscan.h"
+#include "display.h"
+#include "kernel.h"
+#include <freertos/semphr.h>
+#include <limits.h>
+
+// WiFi scans run asynchronously in a short-lived "wifiscan" process and
+// land in a cache, so scanwifi prints the last results at once instead of
+// blocking the shell for the few seconds a scan takes. When a refresh
+// finishes, only the networks that were not in the previous result are
+// printed.
+
+static ScanEntry results[SCAN_MAX_RESULTS];
+static int resultCount = 0;
+static uint32_t scannedAt = 0;
+static bool haveResults = false;
+static volatile bool scanning = false;
+static SemaphoreHandle_t scanMutex = NULL;
+
+static void scanInit() {
+    if (scanMutex == NULL) scanMutex = xSemaphoreCreateMutex();
+}
+
+static const char* encryptionName(wifi_auth_mode_t mode) {
+    switch (mode) {
+        case WIFI_AUTH_OPEN:         return "Open";
+        case WIFI_AUTH_WEP:          return "WEP";
+        case WIFI_AUTH_WPA_PSK:      return "WPA";
+        case WIFI_AUTH_WPA2_PSK:     return "WPA2";
+        case WIFI_AUTH_WPA_WPA2_PSK: return "WPA/2";
+        case WIFI_AUTH_WPA2_ENTERPRISE: return "WPA2-E";
+        case WIFI_AUTH_WPA3_PSK:     return "WPA3";
+        case WIFI_AUTH_WPA2_WPA3_PSK: return "WPA2/3";
+        default:                     return "?";
+    }
+}
+
+static void formatEntry(char* line, const ScanEntry& e) {
+    sprintf(line, "  %-20.20s %4d  %2d  %s", e.ssid[0] ? e.ssid : "(hidden)",
+            e.rssi, e.channel, encryptionName(e.encryption));
+}
+
+static bool seenBefore(const ScanEntry* old, int oldCount, const uint8_t* bssid) {
+    for (int i = 0; i < oldCount; i++) {
+        if (memcmp(old[i].bssid, bssid, 6) == 0) return true;
+    }
+    return false;
+}
+
+static void scanProcess(void* parameter) {
+    int n = WiFi.scanNetworks(true);
+    uint32_t start = millis();
+    while (n == WIFI_SCAN_RUNNING && millis() - start < SCAN_TIMEOUT_MS) {
+        vTaskDelay(SCAN_POLL_MS / portTICK_PERIOD_MS);
+        n = WiFi.scanComplete();
+    }
+
+    if (n < 0) {
+        printLine("scan: failed");
+        WiFi.scanDelete();
+        scanning = false;
+        exitProcess();
+        return;
+    }
+
+    static ScanEntry fresh[SCAN_MAX_RESULTS];
+    int count = min(n, SCAN_MAX_RESULTS);
+    for (int i = 0; i < count; i++) {
+        ScanEntry& e = fresh[i];
+        strlcpy(e.ssid, WiFi.SSID(i).c_str(), sizeof(e.ssid));
+        memcpy(e.bssid, WiFi.BSSID(i), 6);
+        e.rssi = WiFi.RSSI(i);
+        e.channel = WiFi.channel(i);
+        e.encryption = WiFi.encryptionType(i);
+    }
+    WiFi.scanDelete();
+
+    xSemaphoreTake(scanMutex, portMAX_DELAY);
+    bool first = !haveResults;
+    int added = 0;
+    int gone = 0;
+    char line[60];
+    for (int i = 0; i < count; i++) {
+        if (first || seenBefore(results, resultCount, fresh[i].bssid)) continue;
+        if (added++ == 0) printLine("scan: new networks:");
+        formatEntry(line, fresh[i]);
+        printLine(line);
+    }
+    if (!first) {
+        for (int i = 0; i < resultCount; i++) {
+            if (!seenBefore(fresh, count, results[i].bssid)) gone++;
+        }
+    }
+
+    memcpy(results, fresh, sizeof(ScanEntry) * count);
+    resultCount = count;
+    scannedAt = millis();
+    haveResults = true;
+    xSemaphoreGive(scanMutex);
+
+    if (first) {
+        printLine("scan: " + String(count) + " networks, run 'scanwifi' to list");
+    } else if (added > 0 || gone > 0) {
+        printLine("scan: " + String(count) + " networks (" + String(added) + " new, " +
+                  String(gone) + " gone)");
+    }
+
+    scanning = false;
+    exitProcess();
+}
+
+// Starts a background scan unless one is running. Returns false if it
+// could not be started.
+bool scanRefresh() {
+    scanInit();
+    if (scanning) return true;
+
+    scanning = true;
+    if (createProcess(scanProcess, "wifiscan", SCAN_STACK, 1) < 0) {
+        scanning = false;
+        return false;
+    }
+    return true;
+}
+
+static bool entryBefore(const ScanEntry& a, const ScanEntry& b, ScanSort sort) {
+    switch (sort) {
+        case SCAN_SORT_CHANNEL:
+            if (a.channel != b.channel) return a.channel < b.channel;
+            return a.rssi > b.rssi;
+        case SCAN_SORT_SSID:
+            return strcasecmp(a.ssid, b.ssid) < 0;
+        default:
+            return a.rssi > b.rssi;
+    }
+}
+
+// Prints the cached results and refreshes them in the background when
+// they are stale. With wait, blocks until a fresh scan is in.
+void scanWiFi(const ScanFilter& filter, bool wait) {
+    scanInit();
+
+    bool stale = !haveResults || millis() - scannedAt > SCAN_FRESH_MS;
+    if ((stale || wait) && !scanRefresh()) {
+        printLine("scan: cannot start scan");
+    }
+    if (wait) {
+        printLine("Scanning networks...");
+        while (scanning) vTaskDelay(SCAN_POLL_MS / portTICK_PERIOD_MS);
+    }
+
+    if (!haveResults) {
+        printLine("Scanning networks in the background...");
+        return;
+    }
+
+    static ScanEntry view[SCAN_MAX_RESULTS];
+    int count = 0;
+    xSemaphoreTake(scanMutex, portMAX_DELAY);
+    uint32_t age = (millis() - scannedAt) / 1000;
+    int total = resultCount;
+    for (int i = 0; i < resultCount; i++) {
+        const ScanEntry& e = results[i];
+        if (filter.channel && e.channel != filter.channel) continue;
+        if (e.rssi < filter.minRssi) continue;
+
+        int j = count++;
+        while (j > 0 && entryBefore(e, view[j - 1], filter.sort)) {
+            view[j] = view[j - 1];
+            j--;
+        }
+        view[j] = e;
+    }
+    xSemaphoreGive(scanMutex);
+
+    char line[60];
+    sprintf(line, "%d of %d networks, %lus old%s", count, total, (unsigned long)age,
+            scanning ? ", refreshing" : "");
+    printLine(line);
+    printLine("  SSID                 RSSI  Ch  Enc");
+    for (int i = 0; i < count; i++) {
+        formatEntry(line, view[i]);
+        printLine(line);
+    }
+}
+
+// 2.4 GHz channels five or more apart do not overlap; closer ones share
+// airtime. Load counts every network whose 20 MHz channel overlaps.
+void scanChannels() {
+    scanInit();
+    if (!haveResults) {
+        scanRefresh();
+        printLine("Scanning networks in the background...");
+        return;
+    }
+
+    int onChannel[15] = {0};
+    int best[15];
+    for (int c = 0; c < 15; c++) best[c] = -128;
+
+    xSemaphoreTake(scanMutex, portMAX_DELAY);
+    for (int i = 0; i < resultCount; i++) {
+        int c = results[i].channel;
+        if (c < 1 || c > 14) continue;
+        onChannel[c]++;
+        if (results[i].rssi > best[c]) best[c] = results[i].rssi;
+    }
+    xSemaphoreGive(scanMutex);
+
+    char line[60];
+    printLine("Ch  APs  Best  Load");
+    int quietest = 1;
+    int quietLoad = INT_MAX;
+    for (int c = 1; c <= 13; c++) {
+        int load = 0;
+        for (int d = -4; d <= 4; d++) {
+            if (c + d >= 1 && c + d <= 14) load += onChannel[c + d];
+        }
+        if ((c == 1 || c == 6 || c == 11) && load < quietLoad) {
+            quietLoad = load;
+            quietest = c;
+        }
+        if (onChannel[c] == 0 && load == 0) continue;
+
+        char bar[21];
+        int n = min(load, 20);
+        memset(bar, '#', n);
+        bar[n] = '\0';
+        if (onChannel[c] > 0) {
+            sprintf(line, "%2d  %3d  %4d  %3d %s", c, onChannel[c], best[c], load, bar);
+        } else {
+            sprintf(line, "%2d  %3d     -  %3d %s", c, 0, load, bar);
+        }
+        printLine(line);
+    }
+    printLine("Least loaded of 1/6/11: channel " + String(quietest));
+}